@@ -0,0 +1,349 @@
+#include "log/log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "apps/types.hpp"
+#include "apps/io/serialize.hpp"
+#include "lib/random.hpp"
+#include "time/timer.hpp"
+#include "fora.hpp"
+#include "graph.hpp"
+#include "simple_walk.hpp"
+#include "sparse_vector.hpp"
+#include "uniqueue.hpp"
+#include "windex_inc.hpp"
+
+constexpr char help[] =
+  "bench [options]\n"
+  "options:\n"
+  "  --n <list of numbers of nodes>\n"
+  "  --degree <list of average degrees>\n"
+  "  --alpha <list of alphas>\n"
+  "  --epsilon <list of epsilons>\n"
+  "  --kernels <list of kernels>\n"
+  "  --reps <repetitions of each kernel>\n"
+  "  --queries <queries per repetition of evaluation kernels>\n"
+  "  --output <csv file>\n"
+  "  --baseline <csv file to compare with>\n"
+  "  --tolerance <slowdown ratio tolerated against baseline>\n"
+  "kernels: random_walk, forward_push, combine, sparse_accumulate,\n"
+  "  sparse_iterize, uniqueue, windex_insert, windex_delete,\n"
+  "  graph_insert, graph_delete, serialize, deserialize\n";
+
+struct params {
+  node_id n;
+  double degree;
+  double alpha;
+  double eps;
+};
+
+struct {
+  double alpha;
+  double beta = 1.0;
+  double eps;
+  double det_exp = 1.0;
+  double det_fac = 1.0;
+  double pf_exp = 1.0;
+} config;
+
+size_t reps = 5;
+size_t queries = 10;
+std::vector<std::string> kernels;
+
+// median and minimum nanoseconds per operation, keyed by kernel and params
+std::map<std::string, std::pair<double, double>> results;
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ns(clock_type::time_point since) {
+  return std::chrono::duration<double, std::nano>(
+    clock_type::now() - since).count();
+}
+
+std::string result_key(const char* kernel, const params& p) {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s,%zu,%g,%g,%g",
+    kernel, (size_t)p.n, p.degree, p.alpha, p.eps);
+  return buf;
+}
+
+bool enabled(const char* kernel) {
+  return kernels.empty() ||
+    std::find(kernels.begin(), kernels.end(), kernel) != kernels.end();
+}
+
+void report(const char* kernel, const params& p, size_t ops,
+  std::vector<double>& ns)
+{
+  std::sort(ns.begin(), ns.end());
+  double med = ns[ns.size() / 2] / ops, min = ns.front() / ops;
+  results[result_key(kernel, p)] = {med, min};
+  fprintf(stdout, "%-18s n = %-8zu degree = %-6g alpha = %-5g eps = %-5g "
+    "%12.1f ns/op (min %.1f)\n",
+    kernel, (size_t)p.n, p.degree, p.alpha, p.eps, med, min);
+  fflush(stdout);
+}
+
+// times `reps` runs of f, each performing `ops` operations
+void run(const char* kernel, const params& p, size_t ops,
+  std::function<void()> f)
+{
+  if (!enabled(kernel) || ops == 0) return;
+  std::vector<double> ns;
+  for (size_t r = 0; r < reps; ++r) {
+    auto start = clock_type::now();
+    f();
+    ns.push_back(elapsed_ns(start));
+  }
+  report(kernel, p, ops, ns);
+}
+
+// erdos-renyi directed graph without self loops
+edge_list generate(const params& p) {
+  edge_list edges;
+  double prob = std::min(1.0, p.degree / p.n);
+  for (node_id u = 1; u <= p.n; ++u) {
+    for (node_id v = 0; ; ) {
+      v += rand_geometric(prob);
+      if (v > p.n) break;
+      if (u != v) edges.emplace_back(u, v);
+    }
+  }
+  return edges;
+}
+
+edge_list sample_edges(const edge_list& edges, size_t k) {
+  edge_list ret;
+  for (size_t i = 0; i < k; ++i)
+    ret.push_back(edges[rand_uniform(edges.size())]);
+  std::sort(ret.begin(), ret.end());
+  ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+  return ret;
+}
+
+struct walker : public simple_walk {
+  using simple_walk::random_walk;
+};
+
+void bench_walk(const params& p, graph* g) {
+  walker w;
+  size_t walks = std::max<size_t>(p.n, 1 << 16);
+  run("random_walk", p, walks, [&]() {
+    node_id acc = 0;
+    for (size_t i = 0; i < walks; ++i)
+      acc ^= w.random_walk(g, 1 + rand_uniform(p.n), p.alpha);
+    asm volatile("" : : "r"(acc));
+  });
+}
+
+// pushes and refinements are timed by the timers of the evaluation
+void bench_evaluate(const params& p, const edge_list& edges) {
+  if (!enabled("forward_push") && !enabled("combine")) return;
+  fora<windex_inc> f(true, p.n, edges, config);
+  std::vector<double> push_ns, combine_ns;
+  for (size_t r = 0; r < reps; ++r) {
+    Timer::reset_all();
+    for (size_t q = 0; q < queries; ++q)
+      f.evaluate_full(1 + rand_uniform(p.n), [](const std::vector<double>&){});
+    push_ns.push_back(Timer::latency(TIMER::PUSH).sum());
+    combine_ns.push_back(Timer::latency(TIMER::REFINE).sum());
+  }
+  if (enabled("forward_push")) report("forward_push", p, queries, push_ns);
+  if (enabled("combine")) report("combine", p, queries, combine_ns);
+}
+
+void bench_containers(const params& p) {
+  // below 1/64 of the nodes, so that the occurrence list is kept
+  size_t k = std::max<size_t>(p.n >> 7, 1);
+  std::vector<node_id> ids(k);
+  for (node_id& v : ids) v = 1 + rand_uniform(p.n);
+  sparse_vector vec(p.n + 1);
+  run("sparse_accumulate", p, k, [&]() {
+    for (node_id v : ids) vec.accumulate(v, 1.0);
+    vec.clear();
+  });
+  run("sparse_iterize", p, 1, [&]() {
+    for (node_id v : ids) vec.accumulate(v, 1.0);
+    vec.iterize();
+    double acc = 0;
+    for (node_id v : vec) acc += vec[v];
+    asm volatile("" : : "r"(acc));
+    vec.clear();
+  });
+
+  std::vector<node_id> acts(p.n);
+  for (node_id& v : acts) v = 1 + rand_uniform(p.n);
+  uniqueue queue(p.n + 1);
+  run("uniqueue", p, acts.size(), [&]() {
+    node_id acc = 0;
+    for (node_id v : acts) queue.push(v);
+    while (!queue.empty()) acc ^= queue.pop();
+    asm volatile("" : : "r"(acc));
+  });
+}
+
+// a batch of existing edges is deleted and inserted back in each repetition
+template <typename F, typename G>
+void bench_updates(const char* ins_name, const char* del_name,
+  const params& p, const edge_list& batch, F insert, G erase)
+{
+  if (!enabled(ins_name) && !enabled(del_name)) return;
+  std::vector<double> ins_ns, del_ns;
+  for (size_t r = 0; r < reps; ++r) {
+    auto start = clock_type::now();
+    for (auto [u, v] : batch) erase(u, v);
+    del_ns.push_back(elapsed_ns(start));
+    start = clock_type::now();
+    for (auto [u, v] : batch) insert(u, v);
+    ins_ns.push_back(elapsed_ns(start));
+  }
+  if (enabled(ins_name)) report(ins_name, p, batch.size(), ins_ns);
+  if (enabled(del_name)) report(del_name, p, batch.size(), del_ns);
+}
+
+void bench_graph(const params& p, const edge_list& edges, graph* g) {
+  edge_list batch = sample_edges(edges, std::min<size_t>(edges.size(), 4096));
+  if (batch.empty()) return;
+  bench_updates("graph_insert", "graph_delete", p, batch,
+    [g](node_id u, node_id v) { g->insert_edge(u, v); },
+    [g](node_id u, node_id v) { g->delete_edge(u, v); });
+
+  if (!enabled("windex_insert") && !enabled("windex_delete")) return;
+  windex_inc h(g, true, config);
+  bench_updates("windex_insert", "windex_delete", p, batch,
+    [g, &h](node_id u, node_id v) {
+      h.update_insert(u, v, g->insert_edge(u, v).value());
+    },
+    [g, &h](node_id u, node_id v) {
+      h.update_delete(u, v, g->delete_edge(u, v).value());
+    });
+}
+
+void bench_serialize(const params& p, const edge_list& edges) {
+  __serialize_detail::stream res;
+  run("serialize", p, edges.size(), [&]() {
+    res.clear();
+    serialize(edges, res);
+  });
+  if (res.empty()) serialize(edges, res);
+  run("deserialize", p, edges.size(), [&]() {
+    edge_list ret = deserialize<edge_list>(res);
+    asm volatile("" : : "r"(ret.data()));
+  });
+}
+
+void bench(const params& p) {
+  config.alpha = p.alpha;
+  config.eps = p.eps;
+  edge_list edges = generate(p);
+  log_info("graph generated, n = %zu, m = %zu",
+    (size_t)p.n, (size_t)edges.size());
+  graph g(p.n);
+  for (auto [u, v] : edges) g.insert_edge(u, v);
+
+  bench_walk(p, &g);
+  bench_evaluate(p, edges);
+  bench_containers(p);
+  bench_graph(p, edges, &g);
+  bench_serialize(p, edges);
+}
+
+bool save_results(const std::string& filename) {
+  FILE* f = fopen(filename.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "kernel,n,degree,alpha,epsilon,median_ns,min_ns\n");
+  for (auto& [key, r] : results)
+    fprintf(f, "%s,%.3f,%.3f\n", key.c_str(), r.first, r.second);
+  fclose(f);
+  return true;
+}
+
+// returns the number of kernels slower than the baseline beyond tolerance
+size_t compare_results(const std::string& filename, double tolerance) {
+  FILE* f = fopen(filename.c_str(), "r");
+  if (!f) {
+    log_fatal("cannot open baseline '%s'", filename.c_str());
+    exit(1);
+  }
+  char line[512];
+  size_t n_slow = 0;
+  fprintf(stdout, "comparison with baseline '%s'\n", filename.c_str());
+  // skip the header
+  if (!fgets(line, sizeof(line), f)) line[0] = 0;
+  while (fgets(line, sizeof(line), f)) {
+    std::vector<std::string> cols = split(std::string(line), ",");
+    if (cols.size() < 7) continue;
+    std::string key = cols[0];
+    for (size_t i = 1; i < 5; ++i) key += "," + cols[i];
+    auto it = results.find(key);
+    if (it == results.end()) continue;
+    double base = atof(cols[5].c_str()), cur = it->second.first;
+    double ratio = cur / base;
+    bool slow = ratio > 1 + tolerance;
+    n_slow += slow;
+    fprintf(stdout, "%-48s %12.1f -> %12.1f ns/op (x%.3f)%s\n",
+      key.c_str(), base, cur, ratio, slow ? " slower" : "");
+  }
+  fclose(f);
+  return n_slow;
+}
+
+std::vector<double> parse_list(const char* s) {
+  std::vector<double> ret;
+  for (const std::string& x : split(s, ",")) ret.push_back(atof(x.c_str()));
+  return ret;
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<double> ns {10000}, degrees {10}, alphas {0.2}, epss {0.5};
+  std::string output, baseline;
+  double tolerance = 0.1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--n") == 0) {
+      ns = parse_list(argv[++i]);
+    } else if (strcmp(argv[i], "--degree") == 0) {
+      degrees = parse_list(argv[++i]);
+    } else if (strcmp(argv[i], "--alpha") == 0) {
+      alphas = parse_list(argv[++i]);
+    } else if (strcmp(argv[i], "--epsilon") == 0) {
+      epss = parse_list(argv[++i]);
+    } else if (strcmp(argv[i], "--kernels") == 0) {
+      kernels = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--reps") == 0) {
+      reps = std::max(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--queries") == 0) {
+      queries = std::max(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--output") == 0) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--baseline") == 0) {
+      baseline = argv[++i];
+    } else if (strcmp(argv[i], "--tolerance") == 0) {
+      tolerance = atof(argv[++i]);
+    } else {
+      log_fatal("unknown option %s\nusage:\n%s", argv[i], help);
+      return -1;
+    }
+  }
+
+  // buffers of evaluations are sized by the first graph of the process,
+  // so the largest graphs go first
+  std::sort(ns.rbegin(), ns.rend());
+  for (double n : ns)
+    for (double degree : degrees)
+      for (double alpha : alphas)
+        for (double eps : epss)
+          bench(params { (node_id)n, degree, alpha, eps });
+
+  if (!output.empty() && !save_results(output)) {
+    log_error("failed to save results to '%s'", output.c_str());
+    return -1;
+  }
+  if (!baseline.empty() && compare_results(baseline, tolerance) > 0)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,249 @@
+#include "log/log.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "apps/types.hpp"
+#include "apps/io/file.hpp"
+#include "apps/io/protocol.hpp"
+#include "time/histogram.hpp"
+
+constexpr char help[] =
+  "client <socket_path> <data_path> [options]\n"
+  "options:\n"
+  "  --workloads <list of workloads>\n"
+  "  --batch <number of operations per request>\n"
+  "  --depth <number of requests in flight>\n"
+  "  --output (save results to <data_path>/results/served)\n";
+
+#define filepath(file) (file_path(2, argv[2], file))
+#define workload_path(workload) \
+  (file_path(3, argv[2], "workloads", workload.c_str()))
+#define result_path(workload, file) \
+  (file_path(5, argv[2], "results", "served", workload.c_str(), file))
+#define pair_name(s, t) (std::to_string(s) + "-" + std::to_string(t))
+
+bool read_full(int fd, char* p, size_t len) {
+  while (len > 0) {
+    ssize_t r = read(fd, p, len);
+    if (r <= 0) {
+      if (r < 0 && errno == EINTR) continue;
+      return false;
+    }
+    p += r, len -= r;
+  }
+  return true;
+}
+
+bool write_full(int fd, const char* p, size_t len) {
+  while (len > 0) {
+    ssize_t r = write(fd, p, len);
+    if (r <= 0) {
+      if (r < 0 && errno == EINTR) continue;
+      return false;
+    }
+    p += r, len -= r;
+  }
+  return true;
+}
+
+// the payload of the next frame
+bool read_frame(int fd, std::string& payload) {
+  char head[wire::header_size];
+  if (!read_full(fd, head, sizeof(head))) return false;
+  const char* h = head;
+  payload.resize(wire::get<uint32_t>(h));
+  return read_full(fd, payload.data(), payload.size());
+}
+
+int connect_to(const char* path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || strlen(path) >= sizeof(addr.sun_path)) return -1;
+  strcpy(addr.sun_path, path);
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    log_fatal("missing argument <socket_path> or <data_path>\nusage:\n%s",
+      help);
+    return -1;
+  }
+
+  size_t batch = 1, depth = 1;
+  bool output = false;
+  std::vector<std::string> workloads;
+  for (int i = 3; i < argc; ++i) {
+    if (strcmp(argv[i], "--workloads") == 0) {
+      workloads = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = std::max(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--depth") == 0) {
+      depth = std::max(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--output") == 0) {
+      output = true;
+    } else {
+      log_fatal("unknown option %s\nusage:\n%s", argv[i], help);
+      return -1;
+    }
+  }
+
+  // results are translated to the original ids, as firm saves them
+  std::vector<node_id> mapping;
+  if (output && file_exists(filepath("mapping")))
+    mapping = load_file<std::vector<node_id>>(filepath("mapping"));
+  node_id n = std::get<0>(load_file<graph_meta>(filepath("meta")));
+  auto original = [&mapping](node_id v) {
+    return mapping.empty() ? v : mapping[v];
+  };
+
+  int fd = connect_to(argv[1]);
+  if (fd < 0) {
+    log_fatal("cannot connect to '%s': %s", argv[1], strerror(errno));
+    return -1;
+  }
+
+  // the accuracy configs of the engine, needed to compare saved results
+  std::tuple<double, double, double, double> configs;
+  if (output) {
+    std::string req, resp;
+    update ask = std::make_tuple('#', 0, 0);
+    wire::put_request(req, &ask, 1);
+    if (!write_full(fd, req.data(), req.size()) || !read_frame(fd, resp)) {
+      log_fatal("connection lost");
+      return -1;
+    }
+    // skip the count, op, status and len
+    const char* p = resp.data() + sizeof(uint32_t) + sizeof(char) +
+      sizeof(uint8_t) + sizeof(uint32_t);
+    auto& [alpha, eps, det, pf] = configs;
+    alpha = wire::get<double>(p);
+    eps = wire::get<double>(p);
+    det = wire::get<double>(p);
+    pf = wire::get<double>(p);
+  }
+
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  using clock = std::chrono::steady_clock;
+  static histogram<> latency;
+  for (const std::string& workload : workloads) {
+    auto w = load_file<std::vector<update>>(workload_path(workload));
+    latency.reset();
+    size_t invalid = 0;
+    if (output) save_file(result_path(workload, "meta_configs"), configs);
+
+    // requests are pipelined, up to `depth` of them awaiting responses;
+    // the socket is polled for both directions at once, as the server stops
+    // reading a client that leaves its responses unread
+    std::deque<std::pair<size_t, clock::time_point>> inflight;
+    std::string req, in;
+    size_t sent = 0, next = 0, done = 0;
+    char buf[1 << 16];
+    auto start = clock::now();
+    while (done < w.size()) {
+      while (next < w.size() && inflight.size() < depth) {
+        size_t count = std::min(batch, w.size() - next);
+        wire::put_request(req, w.data() + next, count);
+        inflight.emplace_back(next, clock::now());
+        next += count;
+      }
+
+      pollfd pfd { fd, (short)(POLLIN | (sent < req.size() ? POLLOUT : 0)),
+        0 };
+      if (poll(&pfd, 1, -1) < 0) {
+        if (errno == EINTR) continue;
+        log_fatal("cannot poll: %s", strerror(errno));
+        return -1;
+      }
+      if (pfd.revents & POLLOUT) {
+        ssize_t len = write(fd, req.data() + sent, req.size() - sent);
+        if (len < 0 && errno != EAGAIN && errno != EINTR) {
+          log_fatal("connection lost");
+          return -1;
+        }
+        if (len > 0) sent += len;
+        if (sent == req.size()) req.clear(), sent = 0;
+      }
+      if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+          log_fatal("connection lost");
+          return -1;
+        }
+        if (len > 0) in.append(buf, len);
+      }
+
+      size_t off = 0, fsz;
+      while ((fsz = wire::frame_size(in.data() + off, in.size() - off))) {
+        auto [first, issued] = inflight.front();
+        inflight.pop_front();
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          clock::now() - issued).count());
+
+        const char* p = in.data() + off + wire::header_size;
+        off += fsz;
+        size_t count = wire::get<uint32_t>(p);
+        for (size_t i = 0; i < count; ++i) {
+          char o = wire::get<char>(p);
+          uint8_t status = wire::get<uint8_t>(p);
+          size_t len = wire::get<uint32_t>(p);
+          auto [_, s, t] = w[first + i];
+          std::string name = (o == '<' ? "target-" : "") +
+            std::to_string(original(s));
+          if (status != wire::OK) ++invalid;
+          if ((o == '?' && t == 0) || o == '<') {
+            std::vector<double> ppr(output ? n + 1 : 0);
+            for (size_t j = 0; j < len; ++j) {
+              node_id v = wire::get<node_id>(p);
+              double x = wire::get<double>(p);
+              if (output) ppr[original(v)] = x;
+            }
+            if (output) save_file(result_path(workload, name.c_str()), ppr);
+          } else if (o == '?') {
+            std::vector<node_id> knodes;
+            for (size_t j = 0; j < len; ++j)
+              knodes.push_back(original(wire::get<node_id>(p)));
+            if (output)
+              save_file(result_path(workload, name.c_str()), knodes);
+          } else if (o == '=' && len == 1) {
+            double x = wire::get<double>(p);
+            std::string pname = pair_name(original(s), original(t));
+            if (output) save_file(result_path(workload, pname.c_str()), x);
+          }
+        }
+        done += count;
+      }
+      in.erase(0, off);
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start)
+      .count();
+
+    fprintf(stdout, "workload %s: %zu operation(s) in %.3lf s, "
+      "throughput: %.1lf ops/s, invalid: %zu\n", workload.c_str(), w.size(),
+      elapsed, elapsed > 0 ? w.size() / elapsed : 0., invalid);
+    fprintf(stdout, "latency of requests (us): "
+      "p50: %.1lf, p95: %.1lf, p99: %.1lf, max: %.1lf\n",
+      1e-3 * latency.quantile(.50), 1e-3 * latency.quantile(.95),
+      1e-3 * latency.quantile(.99), 1e-3 * latency.max());
+    fflush(stdout);
+  }
+
+  close(fd);
+  return 0;
+}
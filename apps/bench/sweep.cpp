@@ -0,0 +1,246 @@
+#include "log/log.h"
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "apps/types.hpp"
+
+constexpr char help[] =
+  "sweep <output_csv> [options]\n"
+  "options:\n"
+  "  --datasets <list of data paths, formatted and divided>\n"
+  "  --algos <list of algorithms>\n"
+  "  --workloads <list of workloads>\n"
+  "  --epsilon <list of epsilons>\n"
+  "  --index_ratio <list of index ratios>\n"
+  "  --inacc_ratio <list of inaccuracy ratios>\n"
+  "  --threads <list of numbers of worker threads>\n"
+  "  --bin <directory of the firm, process, vectcmp and topkcmp binaries>\n"
+  "  --no_accuracy\n";
+
+std::string bin = ".";
+
+struct outcome {
+  bool ok;
+  std::string out;
+  double wall_s;
+  long peak_rss_kb;
+};
+
+// run a binary with its output captured, reaping it with wait4 to get the
+// memory high-water mark of this very child
+outcome execute(const std::string& name, std::vector<std::string> args) {
+  std::string path = bin + "/" + name;
+  args.insert(args.begin(), path);
+  std::vector<char*> cargs;
+  for (std::string& a : args) cargs.push_back(a.data());
+  cargs.push_back(nullptr);
+  log_debug("running %s", path.c_str());
+
+  int fds[2];
+  if (pipe(fds) < 0) {
+    log_fatal("cannot create pipe: %s", strerror(errno));
+    exit(1);
+  }
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    log_fatal("cannot fork: %s", strerror(errno));
+    exit(1);
+  }
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv(cargs[0], cargs.data());
+    _exit(127);
+  }
+  close(fds[1]);
+  outcome ret { false, "", 0, 0 };
+  char buf[4096];
+  ssize_t len;
+  while ((len = read(fds[0], buf, sizeof(buf))) > 0) ret.out.append(buf, len);
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  ret.wall_s = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  ret.peak_rss_kb = usage.ru_maxrss;
+  ret.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!ret.ok) log_error("%s failed:\n%s", path.c_str(), ret.out.c_str());
+  return ret;
+}
+
+// value following `key` in the output of a run, or nan when missing
+double scan(const std::string& out, const char* key) {
+  size_t pos = out.rfind(key);
+  if (pos == std::string::npos) return NAN;
+  return atof(out.c_str() + pos + strlen(key));
+}
+
+struct latency {
+  size_t count = 0;
+  double total_s = 0, p50 = NAN, p95 = NAN, p99 = NAN, max = NAN;
+};
+
+// latency statistics of a run, as exported by firm to metrics.csv
+std::map<std::string, latency> load_metrics(const std::string& filename) {
+  std::map<std::string, latency> ret;
+  FILE* f = fopen(filename.c_str(), "r");
+  if (!f) {
+    log_error("cannot open metrics '%s'", filename.c_str());
+    return ret;
+  }
+  char line[512];
+  // skip the header
+  if (!fgets(line, sizeof(line), f)) line[0] = 0;
+  while (fgets(line, sizeof(line), f)) {
+    std::vector<std::string> cols = split(std::string(line), ",");
+    if (cols.size() < 7) continue;
+    latency& l = ret[cols[0]];
+    l.count = atol(cols[1].c_str());
+    l.total_s = atof(cols[2].c_str());
+    l.p50 = atof(cols[3].c_str());
+    l.p95 = atof(cols[4].c_str());
+    l.p99 = atof(cols[5].c_str());
+    l.max = atof(cols[6].c_str());
+  }
+  fclose(f);
+  return ret;
+}
+
+std::string result_folder(const std::string& data, const std::string& algo,
+  const std::string& workload)
+{
+  return data + "/results/" + algo + "/" + workload;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    log_fatal("missing argument <output_csv>\nusage:\n%s", help);
+    return -1;
+  }
+
+  std::vector<std::string> datasets, algos {"firm"}, workloads;
+  std::vector<std::string> epss {"0.5"}, betas {"1"}, thetas {"0.5"};
+  std::vector<std::string> threads {"0"};
+  bool accuracy = true;
+  for (int i = 2; i < argc; ++i) {
+    if (strcmp(argv[i], "--datasets") == 0) {
+      datasets = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--algos") == 0) {
+      algos = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--workloads") == 0) {
+      workloads = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--epsilon") == 0) {
+      epss = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--index_ratio") == 0) {
+      betas = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--inacc_ratio") == 0) {
+      thetas = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      threads = split(argv[++i], ",");
+    } else if (strcmp(argv[i], "--bin") == 0) {
+      bin = argv[++i];
+    } else if (strcmp(argv[i], "--no_accuracy") == 0) {
+      accuracy = false;
+    } else {
+      log_fatal("unknown option %s\nusage:\n%s", argv[i], help);
+      return -1;
+    }
+  }
+  for (const std::string& w : workloads) {
+    size_t _;
+    if (sscanf(w.c_str(), "i%zud%zuq%zuk%zu", &_, &_, &_, &_) != 4) {
+      log_fatal("invalid workload %s\nusage:\n%s", w.c_str(), help);
+      return -1;
+    }
+  }
+
+  FILE* f = fopen(argv[1], "w");
+  if (!f) {
+    log_fatal("cannot open output '%s'", argv[1]);
+    return -1;
+  }
+  fprintf(f, "dataset,algo,workload,epsilon,index_ratio,inacc_ratio,threads,"
+    "ops,throughput_ops,wall_s,peak_rss_kb,"
+    "insert_p50_us,insert_p95_us,insert_p99_us,"
+    "delete_p50_us,delete_p95_us,delete_p99_us,"
+    "query_p50_us,query_p95_us,query_p99_us,query_max_us,"
+    "avg_rel_err,max_rel_err,precision\n");
+
+  for (const std::string& data : datasets) {
+    // workloads are generated once, so that every run sees the same ones
+    std::vector<std::string> args {data};
+    args.insert(args.end(), workloads.begin(), workloads.end());
+    if (!execute("process", args).ok) continue;
+
+    // the ground truth is evaluated by the power method
+    std::map<std::string, bool> truth;
+    for (const std::string& w : workloads) {
+      truth[w] = accuracy && execute("firm",
+        {"exact", data, "--workloads", w, "--output"}).ok;
+    }
+
+    for (const std::string& algo : algos)
+    for (const std::string& eps : epss)
+    for (const std::string& beta : betas)
+    for (const std::string& theta : thetas)
+    for (const std::string& nthr : threads)
+    for (const std::string& w : workloads) {
+      size_t topk, _;
+      sscanf(w.c_str(), "i%zud%zuq%zuk%zu", &_, &_, &_, &topk);
+      std::vector<std::string> args { algo, data, "--workloads", w,
+        "--epsilon", eps, "--index_ratio", beta, "--inacc_ratio", theta,
+        "--threads", nthr };
+
+      // timing runs do not save results, whose writes would be timed
+      outcome o = execute("firm", args);
+      if (!o.ok) continue;
+      auto metrics = load_metrics(
+        result_folder(data, algo, w) + "/metrics.csv");
+      latency ins = metrics["insert"], del = metrics["delete"];
+      latency qry = metrics[topk ? "query_topk" : "query_full"];
+      size_t ops = ins.count + del.count + qry.count;
+      double busy = ins.total_s + del.total_s + qry.total_s;
+
+      double avg_err = NAN, max_err = NAN, prec = NAN;
+      if (truth[w]) {
+        args.push_back("--output");
+        if (execute("firm", args).ok) {
+          outcome c = execute(topk ? "topkcmp" : "vectcmp",
+            {data, "exact", algo, w});
+          avg_err = scan(c.out, "overall average relative error:");
+          max_err = scan(c.out, "overall worst relative error:");
+          prec = scan(c.out, "overall precision:");
+        }
+      }
+
+      fprintf(f, "%s,%s,%s,%s,%s,%s,%s,%zu,%.3f,%.3f,%ld,"
+        "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%e,%e,%.4f\n",
+        data.c_str(), algo.c_str(), w.c_str(), eps.c_str(), beta.c_str(),
+        theta.c_str(), nthr.c_str(), ops, busy > 0 ? ops / busy : 0.,
+        o.wall_s, o.peak_rss_kb,
+        ins.p50, ins.p95, ins.p99, del.p50, del.p95, del.p99,
+        qry.p50, qry.p95, qry.p99, qry.max, avg_err, max_err, prec);
+      fflush(f);
+      fprintf(stdout, "%s %s %s eps = %s beta = %s theta = %s threads = %s: "
+        "%.1f ops/s, %ld KB\n", data.c_str(), algo.c_str(), w.c_str(),
+        eps.c_str(), beta.c_str(), theta.c_str(), nthr.c_str(),
+        busy > 0 ? ops / busy : 0., o.peak_rss_kb);
+      fflush(stdout);
+    }
+  }
+  fclose(f);
+  return 0;
+}
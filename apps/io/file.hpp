@@ -19,15 +19,25 @@ std::string file_path(size_t n, ...) {
   return ret;
 }
 
-// save a serialized file
-template <class T>
-bool save_file(const std::string& filename, const T& data) {
-  log_info("saving file '%s'", filename.c_str());
+bool file_exists(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return file.good();
+}
+
+// create the folder containing a file
+void make_folder(const std::string& filename) {
   std::size_t delpos = filename.find_last_of("/");
   if (delpos !=  std::string::npos) {
-    std::string cmd = "mkdir -p " + filename.substr(0, delpos);
+    std::string cmd = "mkdir -p '" + filename.substr(0, delpos) + "'";
     std::system(cmd.c_str());
   }
+}
+
+// save a serialized file
+template <class T>
+bool save_file(const std::string& filename, const T& data) {
+  log_info("saving file '%s'", filename.c_str());
+  make_folder(filename);
 
   std::ofstream file(filename, std::ios::binary);
   if (file.eof() || file.fail()) {
@@ -66,3 +76,52 @@ T load_file(const std::string& filename) {
   log_info("file '%s' loaded", filename.c_str());
   return ret;
 }
+
+// save a serialized vector of plain elements piece by piece without holding
+// it in memory, the length ahead of the elements is patched on closing
+template <class T>
+class vector_writer {
+private:
+  FILE* _f;
+  size_t _size;
+
+public:
+  vector_writer(const std::string& filename) : _f(nullptr), _size(0) {
+    log_info("saving file '%s'", filename.c_str());
+    make_folder(filename);
+    _f = fopen(filename.c_str(), "wb");
+    if (!_f || fwrite(&_size, sizeof(_size), 1, _f) != 1) {
+      log_fatal("failed to save file '%s'", filename.c_str());
+      exit(1);
+    }
+  }
+
+  ~vector_writer() { close(); }
+
+  vector_writer(const vector_writer&) = delete;
+  vector_writer& operator =(const vector_writer&) = delete;
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  void write(const T* data, size_t n) {
+    if (n && fwrite(data, sizeof(T), n, _f) != n) {
+      log_fatal("failed to write %zu element(s)", n);
+      exit(1);
+    }
+    _size += n;
+  }
+
+  void write(const std::vector<T>& data) {
+    write(data.data(), data.size());
+  }
+
+  void close() {
+    if (!_f) return;
+    fseek(_f, 0, SEEK_SET);
+    fwrite(&_size, sizeof(_size), 1, _f);
+    fclose(_f);
+    _f = nullptr;
+  }
+};
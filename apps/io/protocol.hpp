@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "apps/types.hpp"
+
+// framing of the socket protocol of `firm --serve`, integers being in host
+// byte order since both ends share the machine, and node_id 32 bits, or 64
+// with ULTRASCALE_GRAPH:
+//   frame    := <uint32 payload bytes> <payload>
+//   request  := <uint32 count> count * (<char op> <node_id u> <node_id v>)
+//   response := <uint32 count> count * (<char op> <uint8 status> <uint32 len>
+//               <body>)
+// operations are those of workloads ('?' with v = k, '<' with v = 0, '=',
+// '+', '-'); the body of a full or target query holds len * (<node_id v>
+// <double ppr>) for non-zero entries, of a top-k query len * <node_id v>,
+// of a pair query len = 1 <double ppr>, and is empty for updates;
+// an operation '#' asks for the accuracy configs of the engine, answered
+// with len = 4 doubles (alpha, epsilon, delta, pf); responses come in the
+// order of requests on every connection
+namespace wire {
+
+constexpr size_t header_size = sizeof(uint32_t);
+constexpr size_t op_size = sizeof(char) + 2 * sizeof(node_id);
+// frames larger than this are rejected as malformed
+constexpr size_t max_frame = 1 << 30;
+
+enum STATUS : uint8_t { OK = 0, INVALID = 1 };
+
+template <typename T>
+void put(std::string& buf, const T& x) {
+  buf.append((const char*)&x, sizeof(T));
+}
+
+template <typename T>
+void put_at(std::string& buf, size_t pos, const T& x) {
+  memcpy(buf.data() + pos, &x, sizeof(T));
+}
+
+template <typename T>
+T get(const char*& p) {
+  T x;
+  memcpy(&x, p, sizeof(T));
+  p += sizeof(T);
+  return x;
+}
+
+// open a frame whose length is patched by end_frame
+size_t begin_frame(std::string& buf) {
+  size_t pos = buf.size();
+  put<uint32_t>(buf, 0);
+  return pos;
+}
+
+void end_frame(std::string& buf, size_t pos) {
+  put_at<uint32_t>(buf, pos, buf.size() - pos - header_size);
+}
+
+// length of the complete frame at the front of [p, p + len), or 0 when it
+// is not entirely received yet
+size_t frame_size(const char* p, size_t len) {
+  if (len < header_size) return 0;
+  size_t body = get<uint32_t>(p);
+  return len - header_size < body ? 0 : header_size + body;
+}
+
+void put_request(std::string& buf, const update* ops, size_t count) {
+  size_t pos = begin_frame(buf);
+  put<uint32_t>(buf, count);
+  for (size_t i = 0; i < count; ++i) {
+    auto [o, u, v] = ops[i];
+    put(buf, o);
+    put(buf, u);
+    put(buf, v);
+  }
+  end_frame(buf, pos);
+}
+
+} // namespace wire
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "log/log.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "apps/io/file.hpp"
+#include "apps/types.hpp"
+#include "time/timer.hpp"
+
+// durable updates: an append-only log of updates, group committed, and
+// checkpoints of the whole graph; the files of a durable folder are
+//   log        := <uint64 seq of the first record> records
+//   record     := <char op> <node_id u> <node_id v> <uint32 checksum>
+//   checkpoint := serialized (uint64 seq, edge_list), seq being the number
+//                 of updates it holds
+// a checkpoint covers the log up to its seq, so recovery loads it and
+// replays the records from there; a torn record ends the log
+namespace durable {
+
+constexpr size_t record_size = sizeof(char) + 2 * sizeof(node_id) +
+  sizeof(uint32_t);
+
+using checkpoint = std::tuple<uint64_t, edge_list>;
+
+uint32_t checksum(const char* p, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) h = (h ^ (uint8_t)p[i]) * 16777619u;
+  return h;
+}
+
+// make a file and its entry in the folder durable
+void sync_path(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) fsync(fd), close(fd);
+  std::size_t delpos = filename.find_last_of("/");
+  std::string folder = delpos == std::string::npos ? "." :
+    filename.substr(0, delpos);
+  fd = open(folder.c_str(), O_RDONLY);
+  if (fd >= 0) fsync(fd), close(fd);
+}
+
+// updates of the log from seq on, and the seq following the last one
+std::vector<update> read_log(const std::string& filename, uint64_t seq,
+  uint64_t& end)
+{
+  std::vector<update> ret;
+  end = seq;
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (!f) return ret;
+  uint64_t base;
+  if (fread(&base, sizeof(base), 1, f) != 1) base = seq;
+  if (base > seq) {
+    log_fatal("log '%s' starts at update %zu, after the checkpoint at %zu",
+      filename.c_str(), (size_t)base, (size_t)seq);
+    exit(1);
+  }
+  char rec[record_size];
+  for (end = base; fread(rec, record_size, 1, f) == 1; ++end) {
+    uint32_t sum;
+    memcpy(&sum, rec + record_size - sizeof(sum), sizeof(sum));
+    if (sum != checksum(rec, record_size - sizeof(sum))) {
+      log_warn("torn record %zu in '%s', ignoring the rest",
+        (size_t)end, filename.c_str());
+      break;
+    }
+    if (end < seq) continue;
+    node_id u, v;
+    memcpy(&u, rec + 1, sizeof(u));
+    memcpy(&v, rec + 1 + sizeof(u), sizeof(v));
+    ret.emplace_back(rec[0], u, v);
+  }
+  fclose(f);
+  if (end < seq) end = seq;
+  return ret;
+}
+
+// the log being appended, updates are buffered and made durable together
+// by one write and fdatasync, once `group` of them are pending or the
+// oldest has waited `group_ms`, or on an explicit commit
+class update_log {
+private:
+  using clock = std::chrono::steady_clock;
+
+  std::string _filename;
+  int _fd;
+  std::string _buf;
+  size_t _group;
+  double _group_ms;
+  uint64_t _seq, _pending;
+  clock::time_point _oldest;
+
+  static void _record(std::string& buf, char o, node_id u, node_id v) {
+    char rec[record_size];
+    rec[0] = o;
+    memcpy(rec + 1, &u, sizeof(u));
+    memcpy(rec + 1 + sizeof(u), &v, sizeof(v));
+    uint32_t sum = checksum(rec, record_size - sizeof(sum));
+    memcpy(rec + record_size - sizeof(sum), &sum, sizeof(sum));
+    buf.append(rec, record_size);
+  }
+
+  // a fresh log of the given records from seq on, replacing the former one
+  // atomically
+  void _open(uint64_t seq, const std::string& records) {
+    std::string tmp = _filename + ".tmp";
+    std::string data((const char*)&seq, sizeof(seq));
+    data += records;
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, data.data(), data.size()) !=
+      (ssize_t)data.size() || fsync(fd) != 0 ||
+      rename(tmp.c_str(), _filename.c_str()) != 0)
+    {
+      log_fatal("cannot create log '%s'", _filename.c_str());
+      exit(1);
+    }
+    close(fd);
+    sync_path(_filename);
+    _fd = open(_filename.c_str(), O_WRONLY | O_APPEND);
+  }
+
+  // the log from seq on, keeping the records logged since; returns the seq
+  // following the last one
+  uint64_t _restart(uint64_t seq) {
+    uint64_t end;
+    std::string records;
+    for (auto [o, u, v] : read_log(_filename, seq, end))
+      _record(records, o, u, v);
+    _open(seq, records);
+    return end;
+  }
+
+public:
+  // continue the log after `seq` updates, dropping any torn tail
+  update_log(const std::string& filename, uint64_t seq, size_t group,
+    double group_ms) :
+    _filename(filename), _fd(-1), _group(group), _group_ms(group_ms),
+    _seq(seq), _pending(0)
+  {
+    make_folder(filename);
+    _seq = _restart(seq);
+  }
+
+  ~update_log() {
+    commit();
+    if (_fd >= 0) close(_fd);
+  }
+
+  update_log(const update_log&) = delete;
+  update_log& operator =(const update_log&) = delete;
+
+  // number of updates logged so far, committed or not
+  uint64_t seq() const noexcept {
+    return _seq;
+  }
+
+  void append(char o, node_id u, node_id v) {
+    if (!_pending++) _oldest = clock::now();
+    _record(_buf, o, u, v);
+    ++_seq;
+    if (_pending >= _group) commit();
+    else commit_due();
+  }
+
+  // commit once the oldest pending update has waited group_ms
+  void commit_due() {
+    if (_pending && std::chrono::duration<double, std::milli>(
+      clock::now() - _oldest).count() >= _group_ms) commit();
+  }
+
+  void commit() {
+    if (!_pending) return;
+    Timer tmr(TIMER::SYNC);
+    for (size_t off = 0; off < _buf.size(); ) {
+      ssize_t len = write(_fd, _buf.data() + off, _buf.size() - off);
+      if (len <= 0) {
+        log_fatal("cannot append to log '%s'", _filename.c_str());
+        exit(1);
+      }
+      off += len;
+    }
+    if (fdatasync(_fd) != 0) {
+      log_fatal("cannot sync log '%s'", _filename.c_str());
+      exit(1);
+    }
+    _buf.clear();
+    _pending = 0;
+  }
+
+  // once a checkpoint holds the updates before seq, the log restarts from
+  // there, with those logged while it was written
+  void truncate(uint64_t seq) {
+    commit();
+    close(_fd);
+    _restart(seq);
+  }
+};
+
+// write a checkpoint atomically: to a temporary file, synced, then renamed
+bool save_checkpoint(const std::string& filename, uint64_t seq,
+  const edge_list& edges)
+{
+  std::string tmp = filename + ".tmp";
+  if (!save_file(tmp, checkpoint(seq, edges))) return false;
+  sync_path(tmp);
+  if (rename(tmp.c_str(), filename.c_str()) != 0) return false;
+  sync_path(filename);
+  return true;
+}
+
+} // namespace durable
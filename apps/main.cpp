@@ -1,18 +1,40 @@
 #include "log/log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "apps/types.hpp"
 #include "io/file.hpp"
+#include "io/protocol.hpp"
+#include "io/update_log.hpp"
+#include "lib/parallel.hpp"
+#include "time/counter.hpp"
 #include "exact_ppr.hpp"
 #include "fora.hpp"
 #include "windex_eager.hpp"
+#include "windex_hub.hpp"
 #include "windex_inc.hpp"
 #include "windex_lazy.hpp"
 #include "windex_realtime.hpp"
+#include "windex_segment.hpp"
 
 constexpr char help[] =
   "exam <algo_name> <data_path> [options]\n"
-  "algo_name: firm, fora, fora+, agenda, agenda*, exact\n"
+  "algo_name: firm, fora, fora+, fora-seg, firm-hub, fora-hub,\n"
+  "  agenda, agenda*, exact\n"
   "options:\n"
   "  --alpha <alpha>\n"
   "  --epsilon <epsilon>\n"
@@ -22,7 +44,27 @@ constexpr char help[] =
   "  --index_ratio <ratio of index size>\n"
   "  --inacc_ratio <ratio of index inaccuracy>\n"
   "  --round <round of exact method>\n"
+  "  --seg_pool <number of walk segments per node>\n"
+  "  --seg_length <number of steps per walk segment>\n"
+  "  --hubs <number of hubs with precomputed push>\n"
+  "  --hub_ratio <ratio of hub push threshold to query threshold>\n"
+  "  --stale_updates <pending updates before rebuilding fora+ index>\n"
+  "  --stale_ms <pending milliseconds before rebuilding fora+ index>\n"
+  "  --threads <number of worker threads>\n"
+  "  --batch <max consecutive full queries answered together>\n"
+  "  --all_sources <top-k kept per source, 0 keeps all above threshold>\n"
+  "  --threshold <least ppr kept by --all_sources, delta by default>\n"
+  "  --sources <workload whose queried sources --all_sources answers>\n"
+  "  --job_memory <MiB of scratch of --all_sources, half the RAM by default>\n"
   "  --workloads <list of workloads>\n"
+  "  --rates <list of arrival rates (operations per second) to replay at>\n"
+  "  --timestamps (replay at the recorded arrival times)\n"
+  "  --servers <number of threads serving replayed operations>\n"
+  "  --serve <unix socket path to serve requests on>\n"
+  "  --durable <folder of the update log and checkpoints>\n"
+  "  --group_commit <max updates per log sync>\n"
+  "  --group_ms <max milliseconds an update waits for its log sync>\n"
+  "  --checkpoint <updates between checkpoints>\n"
   "  --output\n";
 
 struct {
@@ -33,6 +75,12 @@ struct {
   double det_exp = 1.0;
   double det_fac = 1.0;
   double pf_exp = 1.0;
+  size_t seg_pool = 4;
+  size_t seg_length = 3;
+  size_t hubs = 32;
+  double hub_ratio = 0.1;
+  size_t stale_updates = 1;
+  double stale_ms = 0;
 } config;
 
 struct  {
@@ -40,26 +88,102 @@ struct  {
   double alpha = 0.2;
 } exact_config;
 
+struct {
+  std::vector<double> rates;
+  bool timestamps = false;
+  size_t servers = 1;
+} replay_config;
+
+struct {
+  bool run = false;
+  node_id k = 0;
+  double threshold = 0;
+  // all nodes unless the sources of a workload are given
+  std::string sources;
+  // scratch of the workers, 0 for half the physical memory
+  size_t memory_mb = 0;
+} job_config;
+
+struct {
+  std::string folder;
+  size_t group = 64;
+  double group_ms = 10;
+  size_t checkpoint = 1 << 20;
+} durable_config;
+
 #define filepath(file) (file_path(2, argv[2], file))
 #define workload_path(workload) \
   (file_path(3, argv[2], "workloads", workload.c_str()))
+#define timestamp_path(workload) \
+  (file_path(3, argv[2], "timestamps", workload.c_str()))
 #define result_folder(workload) \
   (file_path(4, argv[2], "results", argv[1], workload.c_str()))
 #define result_path(workload, node) \
   (file_path(2, result_folder(workload).c_str(), std::to_string(node).c_str()))
+#define pair_path(workload, s, t) \
+  (file_path(2, result_folder(workload).c_str(), \
+    (std::to_string(s) + "-" + std::to_string(t)).c_str()))
+#define job_path(name) \
+  (file_path(4, argv[2], "results", argv[1], ("all-" + name).c_str()))
+#define target_path(workload, t) \
+  (file_path(2, result_folder(workload).c_str(), \
+    ("target-" + std::to_string(t)).c_str()))
+#define seeds_path(workload) \
+  (file_path(3, argv[2], "seeds", workload.c_str()))
+#define seeds_result_path(workload, i) \
+  (file_path(2, result_folder(workload).c_str(), \
+    ("seeds-" + std::to_string(i)).c_str()))
 
 fora_interface *g;
+node_id num_nodes = 0;
+// full queries answered together when running workloads
+size_t batch_size = 1;
+
+// log of the updates when durable, and the number of them checkpointed
+durable::update_log *ulog = nullptr;
+uint64_t checkpointed = 0;
+
+// the checkpoint being written in the background, the number of updates it
+// holds, and whether it has been written
+std::thread checkpointer;
+uint64_t checkpointing = 0;
+std::atomic<int> checkpoint_state = 0;
+enum { CHECKPOINT_PENDING = 0, CHECKPOINT_SAVED, CHECKPOINT_FAILED };
+
+std::string durable_path(const char* file) {
+  return file_path(2, durable_config.folder.c_str(), file);
+}
+
+// original ids of nodes, empty unless the graph has been reordered
+std::vector<node_id> mapping;
+
+node_id original(node_id v) {
+  return mapping.empty() ? v : mapping[v];
+}
 
 void build_graph(char* argv[]) {
   fprintf(stdout, "loading meta data\n");
   auto [n, m, directed] = load_file<graph_meta>(filepath("meta"));
+  num_nodes = n;
   fprintf(stdout, "n = %zu, m = %zu, %s\n", (size_t)n, (size_t)m,
     directed ? "directed" : "undirected");
   fflush(stdout);
 
   fprintf(stdout, "loading base graph\n");
   fflush(stdout);
-  auto edges = load_file<edge_list>(filepath("graph_base"));
+  edge_list edges;
+  if (durable_config.folder.empty() ||
+    !file_exists(durable_path("checkpoint")))
+  {
+    edges = load_file<edge_list>(filepath("graph_base"));
+  } else {
+    fprintf(stdout, "loading checkpoint\n");
+    fflush(stdout);
+    std::tie(checkpointed, edges) =
+      load_file<durable::checkpoint>(durable_path("checkpoint"));
+  }
+  if (file_exists(filepath("mapping")))
+    mapping = load_file<std::vector<node_id>>(filepath("mapping"));
 
   fprintf(stdout, "building base graph\n");
   fflush(stdout);
@@ -69,57 +193,384 @@ void build_graph(char* argv[]) {
     g = new fora<windex_realtime>(directed, n, edges, config);
   } else if (strcmp(argv[1], "fora+") == 0) {
     g = new fora<windex_eager>(directed, n, edges, config);
+  } else if (strcmp(argv[1], "fora-seg") == 0) {
+    g = new fora<windex_segment>(directed, n, edges, config);
   } else if (strcmp(argv[1], "agenda") == 0) {
     g = new fora<windex_lazy<true>>(directed, n, edges, config);
   } else if (strcmp(argv[1], "agenda*") == 0) {
     g = new fora<windex_lazy<false>>(directed, n, edges, config);
   } else if (strcmp(argv[1], "firm") == 0) {
     g = new fora<windex_inc>(directed, n, edges, config);
+  } else if (strcmp(argv[1], "firm-hub") == 0) {
+    g = new fora<windex_hub<windex_inc>>(directed, n, edges, config);
+  } else if (strcmp(argv[1], "fora-hub") == 0) {
+    g = new fora<windex_hub<windex_realtime>>(directed, n, edges, config);
   } else {
     log_fatal("unknown scheme %s\nusage:\n%s\n", argv[1], help);
     exit(-1);
   }
 }
 
+// recover the updates logged after the checkpoint, and go on logging
+void open_log() {
+  uint64_t end;
+  auto tail = durable::read_log(durable_path("log"), checkpointed, end);
+  for (auto [o, u, v] : tail) {
+    if (o == '+') g->insert_edge(u, v);
+    else g->delete_edge(u, v);
+  }
+  fprintf(stdout, "recovered %zu update(s) after the checkpoint of %zu\n",
+    tail.size(), (size_t)checkpointed);
+  fflush(stdout);
+  ulog = new durable::update_log(durable_path("log"), checkpointed,
+    durable_config.group, durable_config.group_ms);
+}
+
+// once the graph holds every logged update, a snapshot of it replaces the
+// log; only the copy is taken on the update path, the snapshot is written
+// and synced by a thread of its own
+void save_checkpoint() {
+  if (checkpointer.joinable()) return;
+  ulog->commit();
+  checkpointing = ulog->seq();
+  checkpoint_state = CHECKPOINT_PENDING;
+  checkpointer = std::thread(
+    [filename = durable_path("checkpoint"), seq = checkpointing,
+      edges = g->snapshot()]() {
+      checkpoint_state = durable::save_checkpoint(filename, seq, edges) ?
+        CHECKPOINT_SAVED : CHECKPOINT_FAILED;
+    });
+}
+
+// the log is cut once the checkpoint is written, or waited for if `wait`
+void finish_checkpoint(bool wait) {
+  if (!checkpointer.joinable()) return;
+  if (!wait && checkpoint_state == CHECKPOINT_PENDING) return;
+  checkpointer.join();
+  if (checkpoint_state == CHECKPOINT_FAILED) {
+    log_error("cannot save checkpoint, keeping the log");
+    return;
+  }
+  ulog->truncate(checkpointing);
+  checkpointed = checkpointing;
+}
+
+// updates are acknowledged by answers, so a server syncs them before
+// answering anything
+void sync_updates() {
+  if (ulog) ulog->commit();
+}
+
+// updates are logged ahead of being applied when durable
+void apply_update(char o, node_id u, node_id v) {
+  if (ulog) ulog->append(o, u, v);
+  if (o == '+') g->insert_edge(u, v);
+  else g->delete_edge(u, v);
+  if (!ulog) return;
+  finish_checkpoint(false);
+  if (ulog->seq() - checkpointed >= durable_config.checkpoint)
+    save_checkpoint();
+}
+
+// results are saved in original ids
+void save_ppr(const std::string& filename, const std::vector<double>& ppr) {
+  if (mapping.empty()) {
+    save_file(filename, ppr);
+    return;
+  }
+  std::vector<double> oppr(ppr.size());
+  for (node_id v = 1; v < ppr.size(); ++v) oppr[mapping[v]] = ppr[v];
+  save_file(filename, oppr);
+}
+
+void save_topk(const std::string& filename,
+  const std::vector<node_id>& knodes)
+{
+  std::vector<node_id> oknodes(knodes);
+  for (node_id& v : oknodes) v = original(v);
+  save_file(filename, oknodes);
+}
+
+// seed sets of the workload, which '*' operations refer to by index
+std::vector<seed_set> seeds;
+
+void load_seeds(char* argv[], const std::string& workload) {
+  seeds.clear();
+  if (!file_exists(seeds_path(workload))) return;
+  seeds = load_file<std::vector<seed_set>>(seeds_path(workload));
+  // weights are made a distribution, as the guarantees assume
+  for (seed_set& ss : seeds) {
+    double sum = 0;
+    for (auto [s, x] : ss) sum += x;
+    for (auto& [s, x] : ss) x /= sum;
+  }
+}
+
+void handle_operation(char* argv[], const std::string& workload, bool output,
+  char o, node_id u, node_id v)
+{
+  if (o == '?') {
+    node_id s = u, k = v;
+    log_info("querying source %zu", (size_t)s);
+    if (!k) {
+      Timer tmr(TIMER::QUERY_FULL);
+      auto outputer =
+        [output, argv, workload, s] (const std::vector<double>& ppr) {
+          if (output) save_ppr(result_path(workload, original(s)), ppr);
+        };
+      g->evaluate_full(s, outputer);
+    } else {
+      Timer tmr(TIMER::QUERY_TOPK);
+      auto outputer =
+        [output, argv, workload, s] (const std::vector<node_id>& knodes) {
+          if (output) save_topk(result_path(workload, original(s)), knodes);
+        };
+      g->evaluate_topk(s, k, outputer);
+    }
+  } else if (o == '*') {
+    node_id i = u, k = v;
+    if (i >= seeds.size()) {
+      log_error("unknown seed set %zu", (size_t)i);
+      return;
+    }
+    log_info("querying seed set %zu of %zu node(s)", (size_t)i,
+      seeds[i].size());
+    if (!k) {
+      Timer tmr(TIMER::QUERY_FULL);
+      auto outputer =
+        [output, argv, workload, i] (const std::vector<double>& ppr) {
+          if (output) save_ppr(seeds_result_path(workload, i), ppr);
+        };
+      g->evaluate_full(seeds[i], outputer);
+    } else {
+      Timer tmr(TIMER::QUERY_TOPK);
+      auto outputer =
+        [output, argv, workload, i] (const std::vector<node_id>& knodes) {
+          if (output) save_topk(seeds_result_path(workload, i), knodes);
+        };
+      g->evaluate_topk(seeds[i], k, outputer);
+    }
+  } else if (o == '<') {
+    node_id t = u;
+    log_info("querying target %zu", (size_t)t);
+    Timer tmr(TIMER::QUERY_TARGET);
+    // sources are the entries of the result, which is named by the target
+    auto outputer =
+      [output, argv, workload, t] (const std::vector<double>& ppr) {
+        if (output) save_ppr(target_path(workload, original(t)), ppr);
+      };
+    g->evaluate_target(t, outputer);
+  } else if (o == '=') {
+    log_info("querying pair %zu %zu", (size_t)u, (size_t)v);
+    Timer tmr(TIMER::QUERY_PAIR);
+    double ppr = g->evaluate_pair(u, v);
+    if (output) save_file(pair_path(workload, original(u), original(v)), ppr);
+  } else if (o == '+') {
+    Timer tmr(TIMER::INSERT);
+    log_info("inserting edge %zu %zu", (size_t)u, (size_t)v);
+    apply_update(o, u, v);
+  } else if (o == '-') {
+    Timer tmr(TIMER::DELETE);
+    log_info("deleting edge %zu %zu", (size_t)u, (size_t)v);
+    apply_update(o, u, v);
+  } else {
+    log_error("unknown operation %c", o);
+  }
+}
+
+// full queries of consecutive sources answered together
+void handle_batch(char* argv[], const std::string& workload, bool output,
+  const std::vector<node_id>& sources)
+{
+  log_info("querying %zu source(s) in a batch", sources.size());
+  Timer tmr(TIMER::QUERY_BATCH);
+  auto outputer =
+    [output, argv, workload] (node_id s, const std::vector<double>& ppr) {
+      if (output) save_ppr(result_path(workload, original(s)), ppr);
+    };
+  g->evaluate_batch(sources, outputer);
+}
+
+// the all-sources job, whose results are streamed as sources are done, in
+// the format
+//   file   := <node_id k> <double threshold> records
+//   record := <node_id source> <uint32 len> len * (<node_id v> <float ppr>)
+// in original ids, the nodes of a record by descending ppr
+void handle_job(char* argv[], bool output) {
+  std::vector<node_id> sources;
+  if (job_config.sources.empty()) {
+    for (node_id v = 1; v <= num_nodes; ++v) sources.push_back(v);
+  } else {
+    std::vector<char> taken(num_nodes + 1);
+    auto w = load_file<std::vector<update>>(workload_path(job_config.sources));
+    for (auto [o, u, v] : w)
+      if (o == '?' && u >= 1 && u <= num_nodes && !taken[u])
+        taken[u] = 1, sources.push_back(u);
+  }
+  // ppr below delta carries no accuracy guarantee
+  node_id k = job_config.k;
+  double threshold = job_config.threshold > 0 ? job_config.threshold :
+    k ? 0 : g->experiment_configs().delta;
+  log_info("answering %zu source(s), k = %zu, threshold = %e",
+    sources.size(), (size_t)k, threshold);
+
+  FILE* f = nullptr;
+  if (output) {
+    std::string name = job_config.sources.empty() ? std::string("nodes") :
+      job_config.sources;
+    std::string filename = job_path(name);
+    make_folder(filename);
+    f = fopen(filename.c_str(), "wb");
+    if (!f) {
+      log_fatal("cannot create '%s'", filename.c_str());
+      exit(1);
+    }
+    fwrite(&k, sizeof(k), 1, f);
+    fwrite(&threshold, sizeof(threshold), 1, f);
+  }
+
+  std::mutex lock;
+  std::atomic<size_t> kept_total = 0;
+  auto outputer = [&](node_id s, const std::vector<double>& ppr) {
+    using entry = std::pair<double, node_id>;
+    static thread_local std::vector<entry> kept;
+    static thread_local std::string rec;
+    kept.clear();
+    for (node_id v = 1; v < ppr.size(); ++v)
+      if (ppr[v] > 0 && ppr[v] >= threshold) kept.emplace_back(ppr[v], v);
+    if (k && kept.size() > k) {
+      std::nth_element(kept.begin(), kept.begin() + k, kept.end(),
+        std::greater<entry>());
+      kept.resize(k);
+    }
+    std::sort(kept.begin(), kept.end(), std::greater<entry>());
+    kept_total += kept.size();
+    if (!f) return;
+
+    rec.clear();
+    auto put = [](std::string& out, auto x) {
+      out.append((const char*)&x, sizeof(x));
+    };
+    put(rec, original(s));
+    put(rec, (uint32_t)kept.size());
+    for (auto [x, v] : kept) put(rec, original(v)), put(rec, (float)x);
+    std::lock_guard<std::mutex> lk(lock);
+    fwrite(rec.data(), 1, rec.size(), f);
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  size_t max_bytes = job_config.memory_mb << 20;
+  if (!max_bytes)
+    max_bytes = (size_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 2;
+  size_t workers = g->evaluate_all(sources, max_bytes, outputer);
+  double elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  if (f) fclose(f);
+
+  fprintf(stdout, "all sources: %zu source(s) in %.3lf s on %zu worker(s), "
+    "throughput: %.1lf sources/s, kept: %zu ppr(s)\n", sources.size(),
+    elapsed, workers, elapsed > 0 ? sources.size() / elapsed : 0.,
+    kept_total.load());
+  fflush(stdout);
+}
+
+#ifdef WORK_COUNTERS
+// one row of work done per operation
+void log_work(FILE* f, char o, node_id u, node_id v,
+  const Counter::values& before)
+{
+  if (!f) return;
+  fprintf(f, "%c,%zu,%zu", o, (size_t)u, (size_t)v);
+  for (size_t c = 0; c < (size_t)COUNTER::_; ++c)
+    fprintf(f, ",%.9g", Counter::snapshot()[c] - before[c]);
+  fprintf(f, "\n");
+}
+#endif
+
+void print_latency() {
+  for (TIMER op : {
+    TIMER::INSERT, TIMER::DELETE, TIMER::QUERY_FULL, TIMER::QUERY_TOPK,
+    TIMER::QUERY_TARGET, TIMER::QUERY_PAIR, TIMER::QUERY_BATCH })
+  {
+    const histogram<>& h = Timer::latency(op);
+    if (h.count() == 0) continue;
+    fprintf(stdout, "latency of %s (us): "
+      "p50: %.1lf, p95: %.1lf, p99: %.1lf, max: %.1lf\n",
+      timer_names[(size_t)op],
+      1e-3 * h.quantile(.50), 1e-3 * h.quantile(.95),
+      1e-3 * h.quantile(.99), 1e-3 * h.max());
+  }
+}
+
 void handle_workload(char* argv[], std::string workload, bool output) {
   fprintf(stdout, "handling workload %s\n", workload.c_str());
   fflush(stdout);
   Timer::reset_all();
+  Counter::reset_all();
 
   save_file(
     file_path(2, result_folder(workload).c_str(), "meta_configs"),
     g->experiment_configs());
 
+#ifdef WORK_COUNTERS
+  FILE* fwork = fopen(
+    file_path(2, result_folder(workload).c_str(), "counters.csv").c_str(),
+    "w");
+  if (fwork) {
+    fprintf(fwork, "op,u,v");
+    for (const char* name : counter_names) fprintf(fwork, ",%s", name);
+    fprintf(fwork, "\n");
+  }
+#endif
+
+  // consecutive full queries are held back to be answered in a batch,
+  // logged as one row 'B' with the number of sources
+  std::vector<node_id> batch;
+  auto flush = [&]() {
+    if (batch.empty()) return;
+#ifdef WORK_COUNTERS
+    Counter::values before = Counter::snapshot();
+    handle_batch(argv, workload, output, batch);
+    log_work(fwork, 'B', batch.size(), 0, before);
+#else
+    handle_batch(argv, workload, output, batch);
+#endif
+    batch.clear();
+  };
+
   auto w = load_file<std::vector<update>>(workload_path(workload));
+  load_seeds(argv, workload);
   for (auto [o, u, v] : w) {
-    if (o == '?') {
-      node_id s = u, k = v;
-      log_info("querying source %zu", (size_t)s);
-      if (!k) {
-        auto outputer =
-          [output, argv, workload, s] (const std::vector<double>& ppr) {
-            if (output) save_file(result_path(workload, s), ppr);
-          };
-        g->evaluate_full(s, outputer);
-      } else {
-        auto outputer =
-          [output, argv, workload, s] (const std::vector<node_id>& knodes) {
-            if (output) save_file(result_path(workload, s), knodes);
-          };
-        g->evaluate_topk(s, k, outputer);
-      }
-    } else if (o == '+') {
-      log_info("inserting edge %zu %zu", (size_t)u, (size_t)v);
-      g->insert_edge(u, v);
-    } else if (o == '-') {
-      log_info("deleting edge %zu %zu", (size_t)u, (size_t)v);
-      g->delete_edge(u, v);
-    } else {
-      log_error("unknown operation %c", o);
+    // nothing is acknowledged here, so the group settings alone decide
+    if (ulog) ulog->commit_due();
+    if (batch_size > 1 && o == '?' && !v) {
+      batch.push_back(u);
+      if (batch.size() == batch_size) flush();
+      continue;
     }
+    flush();
+#ifdef WORK_COUNTERS
+    Counter::values before = Counter::snapshot();
+    handle_operation(argv, workload, output, o, u, v);
+    log_work(fwork, o, u, v, before);
+#else
+    handle_operation(argv, workload, output, o, u, v);
+#endif
   }
+  flush();
+  sync_updates();
+
+#ifdef WORK_COUNTERS
+  if (fwork) fclose(fwork);
+  fprintf(stdout, "work:");
+  for (size_t c = 0; c < (size_t)COUNTER::_; ++c)
+    fprintf(stdout, " %s: %.9g%s", counter_names[c],
+      Counter::get((COUNTER)c), c + 1 < (size_t)COUNTER::_ ? "," : "\n");
+#endif
 
   fprintf(stdout, "time for updates: %lf\n", Timer::used(TIMER::UPDATE));
+  if (ulog)
+    fprintf(stdout, "time for log syncs: %lf\n", Timer::used(TIMER::SYNC));
   fprintf(stdout, "time for queries: %lf"
     "(adapt: %lf, push: %lf, refine: %lf, check: %lf)\n",
     Timer::used(TIMER::EVALUATE),
@@ -128,6 +579,385 @@ void handle_workload(char* argv[], std::string workload, bool output) {
     Timer::used(TIMER::REFINE),
     Timer::used(TIMER::CHECK_K));
   fprintf(stdout, "time for output: %lf\n", Timer::used(TIMER::OUTPUT));
+  print_latency();
+#ifdef PERF_COUNTERS
+  if (!perf_counter::local().enabled())
+    fprintf(stdout, "hardware events: unavailable\n");
+  else for (size_t id = 0; id < (size_t)TIMER::_; ++id) {
+    if (Timer::latency((TIMER)id).count() == 0) continue;
+    const perf_totals& p = Timer::perf((TIMER)id);
+    uint64_t cyc = p.get(PERF_EVENT::CYCLES);
+    uint64_t ins = p.get(PERF_EVENT::INSTRUCTIONS);
+    fprintf(stdout, "hardware events of %s: cycles: %zu, instructions: %zu "
+      "(ipc: %.2lf), llc misses: %zu, branch misses: %zu\n",
+      timer_names[id], (size_t)cyc, (size_t)ins, cyc ? 1. * ins / cyc : 0.,
+      (size_t)p.get(PERF_EVENT::LLC_MISSES),
+      (size_t)p.get(PERF_EVENT::BRANCH_MISSES));
+  }
+#endif
+  fflush(stdout);
+
+  Timer::export_json(
+    file_path(2, result_folder(workload).c_str(), "metrics.json"));
+  Timer::export_csv(
+    file_path(2, result_folder(workload).c_str(), "metrics.csv"));
+}
+
+// arrival times in seconds of n operations, poisson at the given rate, or
+// the recorded timestamps rescaled to that rate (kept as is when rate = 0)
+std::vector<double> arrivals(char* argv[], const std::string& workload,
+  size_t n, double rate)
+{
+  std::vector<double> at;
+  if (replay_config.timestamps) {
+    at = load_file<std::vector<double>>(timestamp_path(workload));
+    if (at.size() != n) {
+      log_fatal("timestamps of %s do not match its operations",
+        workload.c_str());
+      exit(1);
+    }
+    double scale = rate > 0 && n && at.back() > 0 ? n / at.back() / rate : 1;
+    for (double& t : at) t *= scale;
+  } else {
+    std::mt19937 rand(0);
+    std::exponential_distribution<double> gap(rate);
+    double t = 0;
+    for (size_t i = 0; i < n; ++i) at.push_back(t += gap(rand));
+  }
+  return at;
+}
+
+// open-loop replay: a generator issues operations at their arrival times
+// into a queue, regardless of completions, and servers take them in order;
+// the engine is not reentrant, so it is handed from server to server in the
+// order they took operations, and the response time of an operation
+// includes its wait in the queue and for the engine
+void replay_workload(char* argv[], std::string workload, bool output) {
+  using clock = std::chrono::steady_clock;
+  using ns = std::chrono::nanoseconds;
+
+  auto w = load_file<std::vector<update>>(workload_path(workload));
+  load_seeds(argv, workload);
+  std::vector<double> rates = replay_config.rates;
+  if (rates.empty()) rates.push_back(0);
+
+  std::string folder = result_folder(workload);
+  save_file(file_path(2, folder.c_str(), "meta_configs"),
+    g->experiment_configs());
+  FILE* fcurve = fopen(file_path(2, folder.c_str(), "replay.csv").c_str(),
+    "w");
+  if (fcurve) {
+    fprintf(fcurve, "offered_ops,throughput_ops,p50_us,p95_us,p99_us,max_us,"
+      "update_p99_us,query_p99_us,handoff_p99_us\n");
+  }
+
+  static histogram<> response, update_response, query_response, handoff;
+  for (size_t r = 0; r < rates.size(); ++r) {
+    // every rate starts from the same graph
+    if (r > 0) {
+      delete g;
+      build_graph(argv);
+    }
+    std::vector<double> at = arrivals(argv, workload, w.size(), rates[r]);
+    double offered = at.empty() || at.back() <= 0 ? 0 : w.size() / at.back();
+    fprintf(stdout, "replaying workload %s at %.1f ops/s\n",
+      workload.c_str(), offered);
+    fflush(stdout);
+    Timer::reset_all();
+    response.reset();
+    update_response.reset();
+    query_response.reset();
+    handoff.reset();
+
+    // a server taking an operation draws a ticket, and runs it once the
+    // tickets before have been served, as a mutex would not be fair
+    std::mutex lock;
+    std::condition_variable ready, turn;
+    std::queue<std::pair<size_t, clock::time_point>> pending;
+    bool issued = false;
+    size_t tickets = 0, now_serving = 0;
+    clock::time_point start = clock::now(), finish = start;
+
+    auto serve = [&]() {
+      while (true) {
+        std::unique_lock<std::mutex> lk(lock);
+        ready.wait(lk, [&]() { return !pending.empty() || issued; });
+        if (pending.empty()) return;
+        auto [i, arrival] = pending.front();
+        pending.pop();
+        size_t ticket = tickets++;
+        clock::time_point taken = clock::now();
+        turn.wait(lk, [&]() { return now_serving == ticket; });
+        lk.unlock();
+        handoff.record(std::chrono::duration_cast<ns>(clock::now() - taken)
+          .count());
+
+        auto [o, u, v] = w[i];
+        handle_operation(argv, workload, output, o, u, v);
+        clock::time_point done = clock::now();
+        uint64_t t = std::chrono::duration_cast<ns>(done - arrival).count();
+        response.record(t);
+        (o == '+' || o == '-' ? update_response : query_response).record(t);
+        lk.lock();
+        ++now_serving;
+        finish = std::max(finish, done);
+        turn.notify_all();
+      }
+    };
+    std::vector<std::thread> servers;
+    for (size_t i = 0; i < replay_config.servers; ++i)
+      servers.emplace_back(serve);
+
+    // operations arrive at their scheduled times, so that a late generator
+    // is accounted as queueing rather than hidden
+    for (size_t i = 0; i < w.size(); ++i) {
+      clock::time_point arrival = start +
+        std::chrono::duration_cast<ns>(std::chrono::duration<double>(at[i]));
+      std::this_thread::sleep_until(arrival);
+      std::lock_guard<std::mutex> lk(lock);
+      pending.emplace(i, arrival);
+      ready.notify_one();
+    }
+    {
+      std::lock_guard<std::mutex> lk(lock);
+      issued = true;
+    }
+    ready.notify_all();
+    for (auto& s : servers) s.join();
+
+    double elapsed = std::chrono::duration<double>(finish - start).count();
+    double throughput = elapsed > 0 ? w.size() / elapsed : 0;
+    fprintf(stdout, "offered: %.1lf ops/s, throughput: %.1lf ops/s, "
+      "response (us): p50: %.1lf, p95: %.1lf, p99: %.1lf, max: %.1lf, "
+      "update p99: %.1lf, query p99: %.1lf, handoff p99: %.1lf\n",
+      offered, throughput,
+      1e-3 * response.quantile(.50), 1e-3 * response.quantile(.95),
+      1e-3 * response.quantile(.99), 1e-3 * response.max(),
+      1e-3 * update_response.quantile(.99),
+      1e-3 * query_response.quantile(.99), 1e-3 * handoff.quantile(.99));
+    fflush(stdout);
+    if (fcurve) {
+      fprintf(fcurve, "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+        offered, throughput,
+        1e-3 * response.quantile(.50), 1e-3 * response.quantile(.95),
+        1e-3 * response.quantile(.99), 1e-3 * response.max(),
+        1e-3 * update_response.quantile(.99),
+        1e-3 * query_response.quantile(.99), 1e-3 * handoff.quantile(.99));
+      fflush(fcurve);
+    }
+  }
+  if (fcurve) fclose(fcurve);
+}
+
+volatile sig_atomic_t serving = 1;
+
+// the non-zero entries of a ppr vector, their number patched at len
+void put_ppr(std::string& out, size_t len, const std::vector<double>& ppr) {
+  uint32_t c = 0;
+  for (node_id x = 1; x < ppr.size(); ++x) {
+    if (ppr[x] == 0) continue;
+    wire::put(out, x);
+    wire::put(out, ppr[x]);
+    ++c;
+  }
+  wire::put_at(out, len, c);
+}
+
+// answer one operation of a request frame, results go to the response
+// instead of files
+void serve_operation(char o, node_id u, node_id v, std::string& out) {
+  wire::put(out, o);
+  if (o == '#') {
+    auto [alpha, eps, det, pf] = g->experiment_configs();
+    wire::put<uint8_t>(out, wire::OK);
+    wire::put<uint32_t>(out, 4);
+    for (double x : {alpha, eps, det, pf}) wire::put(out, x);
+    return;
+  }
+  bool valid = u >= 1 && u <= num_nodes &&
+    (o == '?' ? v <= num_nodes : o == '<' ? v == 0 :
+      (o == '=' || o == '+' || o == '-') && v >= 1 && v <= num_nodes);
+  if (!valid) {
+    wire::put<uint8_t>(out, wire::INVALID);
+    wire::put<uint32_t>(out, 0);
+    return;
+  }
+  if (o != '+' && o != '-') sync_updates();
+  wire::put<uint8_t>(out, wire::OK);
+  size_t len = out.size();
+  wire::put<uint32_t>(out, 0);
+  if (o == '?' && !v) {
+    Timer tmr(TIMER::QUERY_FULL);
+    g->evaluate_full(u, [&out, len](const std::vector<double>& ppr) {
+      put_ppr(out, len, ppr);
+    });
+  } else if (o == '?') {
+    Timer tmr(TIMER::QUERY_TOPK);
+    g->evaluate_topk(u, v, [&out, len](const std::vector<node_id>& knodes) {
+      for (node_id x : knodes) wire::put(out, x);
+      wire::put_at<uint32_t>(out, len, knodes.size());
+    });
+  } else if (o == '<') {
+    Timer tmr(TIMER::QUERY_TARGET);
+    g->evaluate_target(u, [&out, len](const std::vector<double>& ppr) {
+      put_ppr(out, len, ppr);
+    });
+  } else if (o == '=') {
+    Timer tmr(TIMER::QUERY_PAIR);
+    wire::put(out, g->evaluate_pair(u, v));
+    wire::put_at<uint32_t>(out, len, 1);
+  } else if (o == '+') {
+    Timer tmr(TIMER::INSERT);
+    apply_update(o, u, v);
+  } else {
+    Timer tmr(TIMER::DELETE);
+    apply_update(o, u, v);
+  }
+}
+
+// answer a request frame, false if it is malformed
+bool serve_request(const char* p, size_t len, std::string& out) {
+  if (len < sizeof(uint32_t)) return false;
+  size_t count = wire::get<uint32_t>(p);
+  if (len != sizeof(uint32_t) + count * wire::op_size) return false;
+  size_t pos = wire::begin_frame(out);
+  wire::put<uint32_t>(out, count);
+  for (size_t i = 0; i < count; ++i) {
+    char o = wire::get<char>(p);
+    node_id u = wire::get<node_id>(p);
+    node_id v = wire::get<node_id>(p);
+    serve_operation(o, u, v, out);
+  }
+  wire::end_frame(out, pos);
+  return true;
+}
+
+// resident mode: clients connect to a unix socket and send frames of
+// operations, pipelining as many as they like; one thread polls every
+// connection and runs the frames in arrival order, since the engine is not
+// reentrant, until SIGINT or SIGTERM
+void serve(const char* path) {
+  // a client reading slowly stops being read beyond this backlog
+  constexpr size_t max_backlog = 64 << 20;
+
+  int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (lfd < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+    log_fatal("cannot create socket '%s'", path);
+    exit(1);
+  }
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(lfd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, 64) < 0) {
+    log_fatal("cannot listen on '%s': %s", path, strerror(errno));
+    exit(1);
+  }
+  fcntl(lfd, F_SETFL, O_NONBLOCK);
+  auto stop = [](int) { serving = 0; };
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  signal(SIGPIPE, SIG_IGN);
+  Timer::reset_all();
+  fprintf(stdout, "serving on %s\n", path);
+  fflush(stdout);
+
+  struct connection {
+    int fd;
+    std::string in, out;
+    size_t sent = 0;
+    // the client stopped sending, or the connection failed
+    bool eof = false, broken = false;
+  };
+  std::vector<connection> conns;
+  std::vector<pollfd> fds;
+  char buf[1 << 16];
+  size_t served = 0;
+  while (serving) {
+    fds.assign(1, pollfd { lfd, POLLIN, 0 });
+    for (connection& c : conns) {
+      short ev = !c.eof && c.out.size() - c.sent < max_backlog ? POLLIN : 0;
+      if (c.sent < c.out.size()) ev |= POLLOUT;
+      fds.push_back(pollfd { c.fd, ev, 0 });
+    }
+    if (poll(fds.data(), fds.size(), 200) < 0) {
+      if (errno == EINTR) continue;
+      log_fatal("cannot poll: %s", strerror(errno));
+      exit(1);
+    }
+
+    for (size_t i = 0; i < conns.size(); ++i) {
+      connection& c = conns[i];
+      short re = fds[i + 1].revents;
+      if (re & (POLLIN | POLLHUP | POLLERR)) {
+        ssize_t len;
+        while ((len = read(c.fd, buf, sizeof(buf))) > 0) c.in.append(buf, len);
+        if (len == 0) c.eof = true;
+        else if (len < 0 && errno != EAGAIN) c.broken = true;
+      }
+
+      size_t off = 0, fsz;
+      while ((fsz = wire::frame_size(c.in.data() + off, c.in.size() - off))) {
+        const char* p = c.in.data() + off + wire::header_size;
+        size_t before = c.out.size();
+        if (!serve_request(p, fsz - wire::header_size, c.out)) {
+          log_error("malformed request, closing connection");
+          c.out.resize(before);
+          c.eof = true;
+          off = c.in.size();
+          break;
+        }
+        served += wire::get<uint32_t>(p);
+        off += fsz;
+      }
+      c.in.erase(0, off);
+      const char* head = c.in.data();
+      if (!c.eof && c.in.size() >= wire::header_size &&
+        wire::get<uint32_t>(head) > wire::max_frame)
+      {
+        log_error("oversized request, closing connection");
+        c.eof = true;
+        c.in.clear();
+      }
+
+      // updates are durable before their answers leave
+      sync_updates();
+      while (c.sent < c.out.size()) {
+        ssize_t len = write(c.fd, c.out.data() + c.sent,
+          c.out.size() - c.sent);
+        if (len <= 0) {
+          if (len < 0 && errno != EAGAIN) c.broken = true;
+          break;
+        }
+        c.sent += len;
+      }
+      if (c.sent == c.out.size()) c.out.clear(), c.sent = 0;
+    }
+
+    // connections are dropped once their answers are flushed or lost
+    for (size_t i = 0; i < conns.size(); ) {
+      connection& c = conns[i];
+      if (!c.broken && !(c.eof && c.out.empty())) ++i;
+      else {
+        close(c.fd);
+        c = std::move(conns.back());
+        conns.pop_back();
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      for (int fd; (fd = accept(lfd, nullptr, nullptr)) >= 0; ) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        conns.push_back(connection { fd, "", "", 0, false, false });
+      }
+    }
+  }
+
+  for (connection& c : conns) close(c.fd);
+  close(lfd);
+  unlink(path);
+  fprintf(stdout, "served %zu operation(s)\n", served);
+  print_latency();
   fflush(stdout);
 }
 
@@ -142,6 +972,7 @@ int main(int argc, char* argv[]) {
   }
 
   bool output = false;
+  const char* socket_path = nullptr;
   std::vector<std::string> workloads;
   for (int i = 3; i < argc; ++i) {
     if (strcmp(argv[i], "--alpha") == 0) {
@@ -188,8 +1019,99 @@ int main(int argc, char* argv[]) {
       }
     } else if (strcmp(argv[i], "--round") == 0) {
       exact_config.round = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seg_pool") == 0) {
+      config.seg_pool = atoi(argv[++i]);
+      if (config.seg_pool == 0) {
+        fprintf(stderr, "invalid seg_pool, must be positive\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--seg_length") == 0) {
+      config.seg_length = atoi(argv[++i]);
+      if (config.seg_length == 0 || config.seg_length > 255) {
+        fprintf(stderr, "invalid seg_length, must be in [1,255]\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--hubs") == 0) {
+      config.hubs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--hub_ratio") == 0) {
+      config.hub_ratio = atof(argv[++i]);
+      if (config.hub_ratio <= 0 || config.hub_ratio > 1) {
+        fprintf(stderr, "invalid hub_ratio, must be in (0,1]\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--stale_updates") == 0) {
+      config.stale_updates = atoi(argv[++i]);
+      if (config.stale_updates == 0) {
+        fprintf(stderr, "invalid stale_updates, must be positive\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--stale_ms") == 0) {
+      config.stale_ms = atof(argv[++i]);
+      if (config.stale_ms < 0) {
+        fprintf(stderr, "invalid stale_ms, must be non-negative\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      parallel_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch_size = atoi(argv[++i]);
+      if (batch_size == 0) {
+        fprintf(stderr, "invalid batch, must be positive\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--all_sources") == 0) {
+      job_config.run = true;
+      job_config.k = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--threshold") == 0) {
+      job_config.threshold = atof(argv[++i]);
+      if (job_config.threshold < 0 || job_config.threshold > 1) {
+        fprintf(stderr, "invalid threshold, must be in [0, 1]\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--sources") == 0) {
+      job_config.sources = argv[++i];
+    } else if (strcmp(argv[i], "--job_memory") == 0) {
+      job_config.memory_mb = atoi(argv[++i]);
     } else if (strcmp(argv[i], "--workloads") == 0) {
       workloads = split(std::string(argv[++i]), ",");
+    } else if (strcmp(argv[i], "--rates") == 0) {
+      for (const std::string& r : split(std::string(argv[++i]), ",")) {
+        replay_config.rates.push_back(atof(r.c_str()));
+        if (replay_config.rates.back() <= 0) {
+          fprintf(stderr, "invalid rates, must be positive\n");
+          return -1;
+        }
+      }
+    } else if (strcmp(argv[i], "--timestamps") == 0) {
+      replay_config.timestamps = true;
+    } else if (strcmp(argv[i], "--servers") == 0) {
+      replay_config.servers = atoi(argv[++i]);
+      if (replay_config.servers == 0) {
+        fprintf(stderr, "invalid servers, must be positive\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--serve") == 0) {
+      socket_path = argv[++i];
+    } else if (strcmp(argv[i], "--durable") == 0) {
+      durable_config.folder = argv[++i];
+    } else if (strcmp(argv[i], "--group_commit") == 0) {
+      durable_config.group = atoi(argv[++i]);
+      if (durable_config.group == 0) {
+        fprintf(stderr, "invalid group_commit, must be positive\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--group_ms") == 0) {
+      durable_config.group_ms = atof(argv[++i]);
+      if (durable_config.group_ms < 0) {
+        fprintf(stderr, "invalid group_ms, must be non-negative\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--checkpoint") == 0) {
+      durable_config.checkpoint = atoi(argv[++i]);
+      if (durable_config.checkpoint == 0) {
+        fprintf(stderr, "invalid checkpoint, must be positive\n");
+        return -1;
+      }
     } else if (strcmp(argv[i], "--output") == 0) {
       output = true;
     } else {
@@ -198,9 +1120,26 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  bool replay = !replay_config.rates.empty() || replay_config.timestamps;
+  if (replay && !durable_config.folder.empty()) {
+    fprintf(stderr, "replays rebuild the graph and cannot be durable\n");
+    return -1;
+  }
+
+#ifdef PERF_COUNTERS
+  // opened before any worker thread starts, so that workers are counted
+  perf_counter::local();
+#endif
   build_graph(argv);
-  for (std::string& workload : workloads)
-    handle_workload(argv, workload, output);
+  if (!durable_config.folder.empty()) open_log();
+  for (std::string& workload : workloads) {
+    if (replay) replay_workload(argv, workload, output);
+    else handle_workload(argv, workload, output);
+  }
+  if (job_config.run) handle_job(argv, output);
+  if (socket_path) serve(socket_path);
+  if (ulog) finish_checkpoint(true);
+  delete ulog;
 
   return 0;
 }
@@ -14,14 +14,15 @@ constexpr char help[] =
 
 #define workload_path(workload) \
   (file_path(3, argv[1], "workloads", workload.c_str()))
-#define truth_path(workload, node) \
-  (file_path( \
-    5, argv[1], "results", argv[2], \
-    workload.c_str(), std::to_string(node).c_str()))
+#define truth_folder(workload) \
+  (file_path(4, argv[1], "results", argv[2], workload.c_str()))
 #define result_folder(workload) \
   (file_path(4, argv[1], "results", argv[3], workload.c_str()))
-#define result_path(workload, node) \
-  (file_path(2, result_folder(workload).c_str(), std::to_string(node).c_str()))
+// results are named by a node, a pair "<s>-<t>" or a seed set "seeds-<i>"
+#define truth_path(workload, name) \
+  (file_path(2, truth_folder(workload).c_str(), name.c_str()))
+#define result_path(workload, name) \
+  (file_path(2, result_folder(workload).c_str(), name.c_str()))
 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
@@ -53,11 +54,19 @@ int main(int argc, char *argv[]) {
     auto [alpha, eps, det, pf] = load_file<fora_interface::econfigs>(
       file_path(2, result_folder(workload).c_str(), "meta_configs"));
     auto updates = load_file<std::vector<update>>(workload_path(workload));
+    // results are named by original ids once the graph is reordered
+    std::vector<node_id> mapping;
+    if (file_exists(file_path(2, argv[1], "mapping")))
+      mapping = load_file<std::vector<node_id>>(
+        file_path(2, argv[1], "mapping"));
     for (auto [c, s, k] : updates) {
-      if (c != '?') continue;
+      // a seed-set query is named by the index of its set
+      if (c != '?' && c != '*') continue;
       if (k == 0) continue;
-      auto vec0 = load_file<std::vector<node_id>>(truth_path(workload, s));
-      auto vec1 = load_file<std::vector<node_id>>(result_path(workload, s));
+      std::string name = c == '*' ? "seeds-" + std::to_string(s) :
+        std::to_string(mapping.empty() ? s : mapping[s]);
+      auto vec0 = load_file<std::vector<node_id>>(truth_path(workload, name));
+      auto vec1 = load_file<std::vector<node_id>>(result_path(workload, name));
       size_t truth_size = vec0.size(), ret_cnt = 0;
       assert(truth_size <= k);
       std::unordered_set<node_id> truth;
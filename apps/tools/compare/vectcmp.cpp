@@ -13,14 +13,16 @@ constexpr char help[] =
 
 #define workload_path(workload) \
   (file_path(3, argv[1], "workloads", workload.c_str()))
-#define truth_path(workload, node) \
-  (file_path( \
-    5, argv[1], "results", argv[2], \
-    workload.c_str(), std::to_string(node).c_str()))
+#define truth_folder(workload) \
+  (file_path(4, argv[1], "results", argv[2], workload.c_str()))
 #define result_folder(workload) \
   (file_path(4, argv[1], "results", argv[3], workload.c_str()))
-#define result_path(workload, node) \
-  (file_path(2, result_folder(workload).c_str(), std::to_string(node).c_str()))
+// results are named by a node, a pair "<s>-<t>", a target "target-<t>" or a
+// seed set "seeds-<i>"
+#define truth_path(workload, name) \
+  (file_path(2, truth_folder(workload).c_str(), name.c_str()))
+#define result_path(workload, name) \
+  (file_path(2, result_folder(workload).c_str(), name.c_str()))
 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
@@ -53,13 +55,38 @@ int main(int argc, char *argv[]) {
     auto [alpha, eps, det, pf] = load_file<fora_interface::econfigs>(
       file_path(2, result_folder(workload).c_str(), "meta_configs"));
     auto updates = load_file<std::vector<update>>(workload_path(workload));
+    // results are named by original ids once the graph is reordered
+    std::vector<node_id> mapping;
+    if (file_exists(file_path(2, argv[1], "mapping")))
+      mapping = load_file<std::vector<node_id>>(
+        file_path(2, argv[1], "mapping"));
     for (auto [c, s, k] : updates) {
-      if (c != '?') continue;
+      // a pair query is a single value, named by both nodes
+      if (c == '=') {
+        node_id src = mapping.empty() ? s : mapping[s];
+        node_id tgt = mapping.empty() ? k : mapping[k];
+        std::string name = std::to_string(src) + "-" + std::to_string(tgt);
+        double x0 = load_file<double>(truth_path(workload, name));
+        double x1 = load_file<double>(result_path(workload, name));
+        if (x0 < det) continue;
+        double err = fabs(x1 - x0) / x0;
+        if (err > 0.5) log_info("%e %e", x1, x0);
+        o_tot_err += err;
+        ++o_tot_nodes;
+        max_err = std::max(max_err, err);
+        continue;
+      }
+      // a target query is named by its target, its entries being sources,
+      // and a seed-set query by the index of its set
+      if (c != '?' && c != '<' && c != '*') continue;
       if (k != 0) continue;
+      std::string node = std::to_string(mapping.empty() ? s : mapping[s]);
+      std::string name = c == '*' ? "seeds-" + std::to_string(s) :
+        c == '<' ? "target-" + node : node;
       size_t cnt = 0;
       double tot_err = .0;
-      auto vec0 = load_file<std::vector<double>>(truth_path(workload, s));
-      auto vec1 = load_file<std::vector<double>>(result_path(workload, s));
+      auto vec0 = load_file<std::vector<double>>(truth_path(workload, name));
+      auto vec1 = load_file<std::vector<double>>(result_path(workload, name));
       if (vec0.size() != vec1.size()) {
         log_error("invaild result with deformed size");
         exit(1);
@@ -1,18 +1,157 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
-#include <fstream>
+#include <queue>
+#include <string>
 #include <tuple>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "apps/io/file.hpp"
 #include "apps/types.hpp"
+#include "lib/parallel.hpp"
 
 constexpr char help[] =
   "format <data_path> [options]\n"
+  "input: <data_path>/text, text.gz or text.zst, one edge per line\n"
   "options:\n"
+  "  --threads <number of worker threads>\n"
   "  --directed|undirected\n";
 
 #define filepath(file) (file_path(2, argv[1], file))
 
+// bytes of compressed input decoded at a time
+constexpr size_t stream_block = 64 << 20;
+
+struct parsed {
+  edge_list edges;
+  node_id n = 0;
+};
+
+// scan the first two integers of every line in [p, e), which starts at a
+// line boundary; lines not starting with a digit (comments) are skipped,
+// as are any columns after the second
+void parse_lines(const char* p, const char* e, bool dird, parsed& out) {
+  while (p < e) {
+    while (p < e && (*p == ' ' || *p == '\t')) ++p;
+    uint64_t x[2];
+    int k = 0;
+    for (; k < 2 && p < e && (unsigned)(*p - '0') < 10; ++k) {
+      uint64_t v = 0;
+      for (; p < e && (unsigned)(*p - '0') < 10; ++p) v = v * 10 + (*p - '0');
+      x[k] = v;
+      while (p < e && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+    }
+    const char* nl = (const char*)memchr(p, '\n', e - p);
+    p = nl ? nl + 1 : e;
+    if (k < 2) continue;
+    node_id u = x[0] + 1, v = x[1] + 1;
+    if (!dird && u > v) std::swap(u, v);
+    out.edges.emplace_back(u, v);
+    out.n = std::max(out.n, std::max(u, v));
+  }
+}
+
+// split [b, e) at line boundaries into one piece per part, appending the
+// edges of piece i to parts[i]
+void parse_parallel(const char* b, const char* e, bool dird,
+  std::vector<parsed>& parts)
+{
+  size_t k = parts.size(), len = e - b;
+  std::vector<const char*> cuts(k + 1, e);
+  cuts[0] = b;
+  for (size_t i = 1; i < k; ++i) {
+    const char* c = std::max(cuts[i - 1], b + len / k * i);
+    const char* nl = (const char*)memchr(c, '\n', e - c);
+    cuts[i] = nl ? nl + 1 : e;
+  }
+  parallel_for(k, [&](size_t i) {
+    parse_lines(cuts[i], cuts[i + 1], dird, parts[i]);
+  });
+}
+
+bool parse_mapped(const std::string& filename, bool dird,
+  std::vector<parsed>& parts)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  fstat(fd, &st);
+  if (st.st_size > 0) {
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      log_fatal("cannot map file '%s'", filename.c_str());
+      exit(1);
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    const char* b = (const char*)data;
+    parse_parallel(b, b + st.st_size, dird, parts);
+    munmap(data, st.st_size);
+  }
+  close(fd);
+  return true;
+}
+
+// decode a compressed file through its command-line decoder, parsing each
+// block of whole lines in parallel
+bool parse_stream(const std::string& filename, const char* decoder,
+  bool dird, std::vector<parsed>& parts)
+{
+  if (access(filename.c_str(), R_OK) != 0) return false;
+  std::string cmd = std::string(decoder) + " -dc '" + filename + "'";
+  FILE* f = popen(cmd.c_str(), "r");
+  if (!f) {
+    log_fatal("cannot run '%s'", cmd.c_str());
+    exit(1);
+  }
+  std::vector<char> buf(stream_block);
+  size_t rest = 0;
+  while (true) {
+    size_t len = rest + fread(buf.data() + rest, 1, buf.size() - rest, f);
+    if (len == rest) break;
+    const char* b = buf.data();
+    const char* nl = (const char*)memrchr(b, '\n', len);
+    // a single line longer than the buffer
+    if (!nl && len == buf.size()) buf.resize(2 * buf.size());
+    size_t used = nl ? nl + 1 - b : 0;
+    if (used) parse_parallel(b, b + used, dird, parts);
+    rest = len - used;
+    memmove(buf.data(), buf.data() + used, rest);
+  }
+  if (rest) parse_parallel(buf.data(), buf.data() + rest, dird, parts);
+  if (pclose(f) != 0) {
+    log_fatal("failed to decode '%s'", filename.c_str());
+    exit(1);
+  }
+  return true;
+}
+
+// merge sorted parts into the output, dropping duplicates
+edge_id merge_unique(std::vector<parsed>& parts, vector_writer<edge>& out) {
+  using head = std::pair<edge, size_t>;
+  std::priority_queue<head, std::vector<head>, std::greater<head>> heap;
+  std::vector<size_t> pos(parts.size(), 0);
+  for (size_t i = 0; i < parts.size(); ++i)
+    if (!parts[i].edges.empty()) heap.emplace(parts[i].edges[0], i);
+
+  edge_list buf;
+  edge last {0, 0};
+  while (!heap.empty()) {
+    auto [e, i] = heap.top();
+    heap.pop();
+    if (e != last) {
+      buf.push_back(last = e);
+      if (buf.size() == (1 << 20)) out.write(buf), buf.clear();
+    }
+    if (++pos[i] < parts[i].edges.size())
+      heap.emplace(parts[i].edges[pos[i]], i);
+  }
+  out.write(buf);
+  return out.size();
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     log_fatal("missing argument <data_path>\nusage:\n%s", help);
@@ -25,35 +164,34 @@ int main(int argc, char *argv[]) {
       dird = true;
     } else if (strcmp(argv[i], "--undirected") == 0) {
       dird = false;
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      parallel_threads = atoi(argv[++i]);
     } else {
       log_fatal("unknown option %s\nusage:\n%s", argv[i], help);
       return -1;
     }
   }
 
-  std::ifstream f_in(filepath("text"));
-  if (f_in.eof() || f_in.fail()) {
+  std::vector<parsed> parts(num_workers());
+  if (!parse_mapped(filepath("text"), dird, parts) &&
+    !parse_stream(filepath("text.gz"), "gzip", dird, parts) &&
+    !parse_stream(filepath("text.zst"), "zstd", dird, parts))
+  {
     log_fatal("cannot open file '%s'", filepath("text").c_str());
     return -1;
   }
 
   node_id n = 0;
-  edge_list edges;
-  for (size_t u, v; f_in >> u >> v; ) {
-    n = std::max(n, (node_id)std::max(u, v) + 1);
-    if (dird)
-      edges.push_back(std::make_pair(u + 1, v + 1));
-    else
-      edges.push_back(std::make_pair(std::min(u, v) + 1, std::max(u, v) + 1));
-  }
-  f_in.close();
+  for (parsed& p : parts) n = std::max(n, p.n);
+  parallel_for(parts.size(), [&parts](size_t i) {
+    std::sort(parts[i].edges.begin(), parts[i].edges.end());
+  });
 
-  std::sort(edges.begin(), edges.end());
-  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
-  edge_id m = edges.size();
+  vector_writer<edge> out(filepath("graph"));
+  edge_id m = merge_unique(parts, out);
+  out.close();
 
   save_file(filepath("meta"), std::make_tuple(n, m, dird));
-  save_file(filepath("graph"), edges);
 
   return 0;
 }
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <random>
@@ -10,14 +11,117 @@
 #include "apps/types.hpp"
 
 constexpr char help[] =
-  "process <data_path> [workloads]\n"
+  "process <data_path> [options] [workloads]\n"
   "workload format:\n"
-  "  i<num insert>d<num delete>q<num query>k<topk>\n"
-  "  <topk> = 0 to generate full queries\n";
+  "  i<num insert>d<num delete>q<num query>k<topk>[<any suffix>]\n"
+  "  <topk> = 0 to generate full queries\n"
+  "options:\n"
+  "  --sources <uniform|zipf|degree>\n"
+  "  --zipf <exponent of zipf sources>\n"
+  "  --burst <number of updates around a node per burst>\n"
+  "  --phases <list of query ratios of consecutive phases>\n"
+  "  --rate <arrivals (operations or bursts) per second, for timestamps>\n"
+  "  --target (full queries ask for the ppr of a target from every source)\n"
+  "  --pair (full queries ask for the ppr of one pair of nodes)\n"
+  "  --seeds <number of weighted sources of each query>\n"
+  "  --seed <random seed>\n";
 
 #define filepath(file) (file_path(2, argv[1], file))
 #define workload_path(workload) \
   (file_path(3, argv[1], "workloads", workload.c_str()))
+#define timestamp_path(workload) \
+  (file_path(3, argv[1], "timestamps", workload.c_str()))
+#define seeds_path(workload) \
+  (file_path(3, argv[1], "seeds", workload.c_str()))
+
+using rng = std::mt19937;
+
+// distribution of query sources and of the centres of update bursts
+class source_picker {
+private:
+  std::uniform_int_distribution<node_id> _uniform;
+  std::discrete_distribution<size_t> _weighted;
+  std::vector<node_id> _ranked;
+
+public:
+  source_picker(node_id n) : _uniform(1, n) { }
+
+  // the i-th node of `ranked` is drawn with the i-th weight
+  source_picker(node_id n, std::vector<node_id> ranked,
+    const std::vector<double>& weights) :
+    _uniform(1, n), _weighted(weights.begin(), weights.end()),
+    _ranked(std::move(ranked)) { }
+
+  node_id operator ()(rng& r) {
+    if (_ranked.empty()) return _uniform(r);
+    return _ranked[_weighted(r)];
+  }
+};
+
+// edges to be inserted or deleted, taken from the back by default or around
+// a node for bursts
+class edge_pool {
+private:
+  edge_list _edges;
+  std::vector<bool> _used;
+  std::vector<std::vector<size_t>> _incident;
+  size_t _back, _left;
+
+  edge _take(size_t i) {
+    _used[i] = true;
+    --_left;
+    return _edges[i];
+  }
+
+public:
+  edge_pool(edge_list edges) :
+    _edges(std::move(edges)), _used(_edges.size()),
+    _back(_edges.size()), _left(_edges.size()) { }
+
+  size_t size() const noexcept {
+    return _left;
+  }
+
+  void index(node_id n) {
+    _incident.assign(n + 1, { });
+    for (size_t i = 0; i < _edges.size(); ++i) {
+      if (_used[i]) continue;
+      _incident[_edges[i].first].push_back(i);
+      _incident[_edges[i].second].push_back(i);
+    }
+  }
+
+  bool has_incident(node_id v) {
+    auto& inc = _incident[v];
+    while (!inc.empty() && _used[inc.back()]) inc.pop_back();
+    return !inc.empty();
+  }
+
+  edge take_back() {
+    while (_used[_back - 1]) --_back;
+    return _take(--_back);
+  }
+
+  // an unused edge incident to v, if any
+  bool take_incident(node_id v, edge& e) {
+    if (!has_incident(v)) return false;
+    e = _take(_incident[v].back());
+    _incident[v].pop_back();
+    return true;
+  }
+};
+
+// the neighbourhood of a node in the base graph, ignoring directions
+std::vector<std::vector<node_id>> load_adjacency(
+  const std::string& filename, node_id n)
+{
+  std::vector<std::vector<node_id>> adj(n + 1);
+  for (auto [u, v] : load_file<edge_list>(filename)) {
+    adj[u].push_back(v);
+    if (u != v) adj[v].push_back(u);
+  }
+  return adj;
+}
 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
@@ -25,11 +129,52 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  std::string sources = "uniform";
+  double zipf = 1.0, rate = 0;
+  size_t burst = 1, n_seeds = 0;
+  bool target = false, pair = false;
+  std::vector<double> phases;
+  unsigned seed = std::random_device{}();
   std::vector<std::string> workloads;
   for (int i = 2; i < argc; ++i) {
     size_t _;
-    bool ok = sscanf(argv[i], "i%zud%zuq%zuk%zu", &_, &_, &_, &_) == 4;
-    if (ok) {
+    if (strcmp(argv[i], "--sources") == 0) {
+      sources = argv[++i];
+      if (sources != "uniform" && sources != "zipf" && sources != "degree") {
+        log_fatal("unknown sources %s\nusage:\n%s", sources.c_str(), help);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--zipf") == 0) {
+      zipf = atof(argv[++i]);
+      if (zipf < 0) {
+        log_fatal("invalid zipf, must be non-negative");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--burst") == 0) {
+      burst = std::max(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--phases") == 0) {
+      for (const std::string& r : split(argv[++i], ",")) {
+        phases.push_back(atof(r.c_str()));
+        if (phases.back() < 0 || phases.back() > 1) {
+          log_fatal("invalid phases, must be ratios in [0,1]");
+          return -1;
+        }
+      }
+    } else if (strcmp(argv[i], "--rate") == 0) {
+      rate = atof(argv[++i]);
+      if (rate < 0) {
+        log_fatal("invalid rate, must be non-negative");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--target") == 0) {
+      target = true;
+    } else if (strcmp(argv[i], "--pair") == 0) {
+      pair = true;
+    } else if (strcmp(argv[i], "--seeds") == 0) {
+      n_seeds = std::max(atoi(argv[++i]), 0);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else if (sscanf(argv[i], "i%zud%zuq%zuk%zu", &_, &_, &_, &_) == 4) {
       workloads.push_back(std::string(argv[i]));
     } else {
       log_fatal("invalid workload %s\nusage:\n%s", argv[i], help);
@@ -37,17 +182,47 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (target + pair + (n_seeds > 0) > 1) {
+    log_fatal("--target, --pair and --seeds are exclusive");
+    return -1;
+  }
+
   auto [n, m, dird] = load_file<graph_meta>(filepath("meta"));
-  auto e_ins = load_file<edge_list>(filepath("edges_ins"));
-  auto e_del = load_file<edge_list>(filepath("edges_del"));
+  edge_pool e_ins(load_file<edge_list>(filepath("edges_ins")));
+  edge_pool e_del(load_file<edge_list>(filepath("edges_del")));
 
-  std::mt19937 rand(std::random_device{}());
-  std::uniform_int_distribution<node_id> rand_node_id(1, n);
+  rng rand(seed);
+  std::vector<std::vector<node_id>> adj;
+  if (sources == "degree" || burst > 1)
+    adj = load_adjacency(filepath("graph_base"), n);
+
+  source_picker pick_source(n);
+  if (sources == "zipf") {
+    // hot nodes are a random permutation of nodes
+    std::vector<node_id> ranked(n);
+    std::vector<double> weights(n);
+    for (node_id i = 0; i < n; ++i) {
+      ranked[i] = i + 1;
+      weights[i] = pow(i + 1, -zipf);
+    }
+    std::shuffle(ranked.begin(), ranked.end(), rand);
+    pick_source = source_picker(n, std::move(ranked), weights);
+  } else if (sources == "degree") {
+    std::vector<node_id> ranked(n);
+    std::vector<double> weights(n);
+    for (node_id i = 0; i < n; ++i) {
+      ranked[i] = i + 1;
+      weights[i] = adj[i + 1].size();
+    }
+    pick_source = source_picker(n, std::move(ranked), weights);
+  }
+  if (burst > 1) {
+    e_ins.index(n);
+    e_del.index(n);
+  }
 
   for (auto& workload : workloads) {
     size_t num_ins, num_del, num_q, topk;
-    std::vector<update> queries;
-
     sscanf(workload.c_str(), "i%zud%zuq%zuk%zu",
       &num_ins, &num_del, &num_q, &topk);
     log_info("generating workload");
@@ -64,29 +239,116 @@ int main(int argc, char *argv[]) {
       continue;
     }
 
-    while (num_ins--) {
-      auto [u, v] = e_ins.back();
-      log_debug("add inserting edge %zu %zu", (size_t)u, (size_t)v);
-      queries.push_back(std::make_tuple('+', u, v));
-      e_ins.pop_back();
+    if ((target || pair) && topk) {
+      log_error("skipped, target and pair queries are full queries");
+      continue;
     }
 
-    while (num_del--) {
-      auto [u, v] = e_del.back();
-      log_debug("add deleting edge %zu %zu", (size_t)u, (size_t)v);
-      queries.push_back(std::make_tuple('-', u, v));
-      e_del.pop_back();
+    // operations are grouped into units that stay contiguous, a unit being
+    // a burst of updates or a single operation
+    std::vector<std::vector<update>> updates, queries;
+    std::vector<seed_set> seeds;
+
+    while (num_ins + num_del > 0) {
+      std::vector<update> unit;
+      // the centre of a burst, with its neighbourhood as a fallback
+      node_id c = 0;
+      if (burst > 1) {
+        for (int t = 0; t < 64 && !c; ++t) {
+          node_id v = pick_source(rand);
+          if (e_ins.has_incident(v) || e_del.has_incident(v)) c = v;
+        }
+      }
+      size_t nbr = 0;
+      while (unit.size() < burst && num_ins + num_del > 0) {
+        bool ins = std::uniform_int_distribution<size_t>(
+          1, num_ins + num_del)(rand) <= num_ins;
+        edge_pool& pool = ins ? e_ins : e_del;
+        edge e;
+        bool near = false;
+        if (c) {
+          near = pool.take_incident(c, e);
+          while (!near && nbr < adj[c].size())
+            if (!(near = pool.take_incident(adj[c][nbr], e))) ++nbr;
+        }
+        if (!near) e = pool.take_back();
+        log_debug("add %s edge %zu %zu", ins ? "inserting" : "deleting",
+          (size_t)e.first, (size_t)e.second);
+        unit.push_back(std::make_tuple(ins ? '+' : '-', e.first, e.second));
+        --(ins ? num_ins : num_del);
+      }
+      updates.push_back(std::move(unit));
     }
 
     while (num_q--) {
-      node_id s =  rand_node_id(rand);
-      log_debug("add query source %zu", (size_t)s);
-      queries.push_back(std::make_tuple('?', s, topk));
+      node_id s = pick_source(rand);
+      if (n_seeds) {
+        // seeds are drawn as sources, with weights normalized
+        seed_set ss;
+        double sum = 0;
+        std::uniform_real_distribution<double> weight(0, 1);
+        while (ss.size() < n_seeds) {
+          ss.emplace_back(ss.empty() ? s : pick_source(rand),
+            1 - weight(rand));
+          sum += ss.back().second;
+        }
+        for (auto& [v, x] : ss) x /= sum;
+        log_debug("add query seed set %zu", seeds.size());
+        queries.push_back({std::make_tuple('*', seeds.size(), topk)});
+        seeds.push_back(std::move(ss));
+        continue;
+      }
+      if (pair) {
+        // targets follow the distribution of sources
+        node_id t = pick_source(rand);
+        log_debug("add query pair %zu %zu", (size_t)s, (size_t)t);
+        queries.push_back({std::make_tuple('=', s, t)});
+        continue;
+      }
+      log_debug("add query %s %zu", target ? "target" : "source", (size_t)s);
+      queries.push_back({std::make_tuple(target ? '<' : '?', s, topk)});
+    }
+
+    // phase i holds a share of queries proportional to its ratio and a
+    // share of updates proportional to the complement, each shuffled; a
+    // single phase mixes everything
+    std::vector<double> mix = phases.empty() ? std::vector<double>{0} : phases;
+    std::vector<std::vector<update>> units;
+    double q_tot = 0, u_tot = 0, q_acc = 0, u_acc = 0;
+    for (double r : mix) q_tot += r, u_tot += 1 - r;
+    size_t q_pos = 0, u_pos = 0;
+    for (size_t p = 0; p < mix.size(); ++p) {
+      q_acc += mix[p], u_acc += 1 - mix[p];
+      size_t q_end = q_tot > 0 ? llround(queries.size() * q_acc / q_tot) : 0;
+      size_t u_end = u_tot > 0 ? llround(updates.size() * u_acc / u_tot) : 0;
+      if (p + 1 == mix.size())
+        q_end = queries.size(), u_end = updates.size();
+      size_t start = units.size();
+      for (; q_pos < q_end; ++q_pos) units.push_back(queries[q_pos]);
+      for (; u_pos < u_end; ++u_pos) units.push_back(updates[u_pos]);
+      std::shuffle(units.begin() + start, units.end(), rand);
     }
 
-    std::shuffle(queries.begin(), queries.end(), rand);
+    std::vector<update> ops;
+    for (auto& unit : units) ops.insert(ops.end(), unit.begin(), unit.end());
+    save_file(workload_path(workload), ops);
+    if (n_seeds) save_file(seeds_path(workload), seeds);
 
-    save_file(workload_path(workload), queries);
+    // poisson arrivals of units, the updates of a burst arriving as many
+    // times faster as the burst is long
+    if (rate > 0) {
+      std::vector<double> timestamps;
+      double t = 0;
+      for (auto& unit : units) {
+        std::exponential_distribution<double> gap(rate * unit.size());
+        for (size_t i = 0; i < unit.size(); ++i) {
+          t += i == 0 ? std::exponential_distribution<double>(rate)(rand) :
+            gap(rand);
+          timestamps.push_back(t);
+        }
+      }
+      save_file(timestamp_path(workload), timestamps);
+    }
   }
 
   return 0;
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "apps/io/file.hpp"
+#include "apps/types.hpp"
+
+constexpr char help[] =
+  "reorder <data_path> [options]\n"
+  "options:\n"
+  "  --order <degree|bfs|rcm|gorder>\n"
+  "  --window <window size of gorder>\n";
+
+#define filepath(file) (file_path(2, argv[1], file))
+
+// adjacency of the graph ignoring directions, plus out- and in-edges
+struct adjacency {
+  node_id n;
+  std::vector<edge_id> offset, out_offset, in_offset;
+  std::vector<node_id> nbrs, outs, ins;
+
+  static void build(node_id n, const edge_list& edges, bool rev,
+    std::vector<edge_id>& offset, std::vector<node_id>& adj)
+  {
+    offset.assign(n + 2, 0);
+    for (auto [u, v] : edges) ++offset[(rev ? v : u) + 1];
+    for (node_id v = 1; v <= n + 1; ++v) offset[v] += offset[v - 1];
+    adj.resize(edges.size());
+    std::vector<edge_id> pos(offset.begin(), offset.end() - 1);
+    for (auto [u, v] : edges) adj[pos[rev ? v : u]++] = rev ? u : v;
+  }
+
+  adjacency(node_id n, const edge_list& edges, bool dird) : n(n) {
+    if (dird) {
+      build(n, edges, false, out_offset, outs);
+      build(n, edges, true, in_offset, ins);
+      edge_list both(edges);
+      for (auto [u, v] : edges) both.emplace_back(v, u);
+      build(n, both, false, offset, nbrs);
+    } else {
+      edge_list both(edges);
+      for (auto [u, v] : edges) if (u != v) both.emplace_back(v, u);
+      build(n, both, false, offset, nbrs);
+      out_offset = in_offset = offset;
+      outs = ins = nbrs;
+    }
+  }
+
+  edge_id degree(node_id v) const {
+    return offset[v + 1] - offset[v];
+  }
+};
+
+// nodes by descending degree, ties broken by id
+std::vector<node_id> order_degree(const adjacency& g) {
+  std::vector<node_id> order(g.n);
+  std::iota(order.begin(), order.end(), 1);
+  std::stable_sort(order.begin(), order.end(), [&g](node_id a, node_id b) {
+    return g.degree(a) > g.degree(b);
+  });
+  return order;
+}
+
+// breadth-first from each unvisited node in the order of roots, with the
+// neighbours of each node visited in the given rank
+template <typename R>
+std::vector<node_id> order_bfs(const adjacency& g,
+  const std::vector<node_id>& roots, R rank)
+{
+  std::vector<node_id> order;
+  std::vector<bool> seen(g.n + 1);
+  std::vector<node_id> nbrs;
+  for (node_id r : roots) {
+    if (seen[r]) continue;
+    seen[r] = true;
+    size_t head = order.size();
+    order.push_back(r);
+    while (head < order.size()) {
+      node_id u = order[head++];
+      nbrs.assign(
+        g.nbrs.begin() + g.offset[u], g.nbrs.begin() + g.offset[u + 1]);
+      std::stable_sort(nbrs.begin(), nbrs.end(), rank);
+      for (node_id v : nbrs) {
+        if (seen[v]) continue;
+        seen[v] = true;
+        order.push_back(v);
+      }
+    }
+  }
+  return order;
+}
+
+// reverse cuthill-mckee, started from nodes of the lowest degree
+std::vector<node_id> order_rcm(const adjacency& g) {
+  std::vector<node_id> roots = order_degree(g);
+  std::reverse(roots.begin(), roots.end());
+  auto by_degree = [&g](node_id a, node_id b) {
+    return g.degree(a) < g.degree(b);
+  };
+  std::vector<node_id> order = order_bfs(g, roots, by_degree);
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// nodes bucketed by score, where scores only move by one at a time, so that
+// every operation takes constant (amortised) time
+class unit_heap {
+private:
+  std::vector<int64_t> _score;
+  std::vector<node_id> _prev, _next, _head;
+  size_t _max;
+
+  void _unlink(node_id v) {
+    if (_prev[v]) _next[_prev[v]] = _next[v];
+    else _head[_score[v]] = _next[v];
+    if (_next[v]) _prev[_next[v]] = _prev[v];
+  }
+
+  void _link(node_id v) {
+    size_t s = _score[v];
+    if (s >= _head.size()) _head.resize(2 * s, 0);
+    _prev[v] = 0;
+    _next[v] = _head[s];
+    if (_head[s]) _prev[_head[s]] = v;
+    _head[s] = v;
+    _max = std::max(_max, s);
+  }
+
+public:
+  unit_heap(node_id n) :
+    _score(n + 1, 0), _prev(n + 1), _next(n + 1), _head(16, 0), _max(0) { }
+
+  // scores of removed nodes are negative
+  void add(node_id v, int64_t d) {
+    if (_score[v] < 0) return;
+    if (_score[v] > 0) _unlink(v);
+    _score[v] += d;
+    if (_score[v] > 0) _link(v);
+  }
+
+  void remove(node_id v) {
+    if (_score[v] > 0) _unlink(v);
+    _score[v] = -1;
+  }
+
+  // a node of the highest positive score, or 0
+  node_id top() {
+    while (_max > 0 && !_head[_max]) --_max;
+    return _head[_max];
+  }
+};
+
+// greedy gorder: the next node maximises the number of edges and common
+// in-neighbours shared with the last `window` placed nodes; common
+// in-neighbours are not counted through nodes of degree above sqrt(n)
+std::vector<node_id> order_gorder(const adjacency& g, size_t window) {
+  edge_id hub = sqrt(g.n);
+  unit_heap heap(g.n);
+
+  // add or remove the contribution of x to the scores
+  auto touch = [&](node_id x, int64_t d) {
+    for (edge_id e = g.out_offset[x]; e < g.out_offset[x + 1]; ++e)
+      heap.add(g.outs[e], d);
+    bool siblings = g.in_offset[x + 1] - g.in_offset[x] <= hub;
+    for (edge_id e = g.in_offset[x]; e < g.in_offset[x + 1]; ++e) {
+      node_id z = g.ins[e];
+      heap.add(z, d);
+      if (!siblings || g.out_offset[z + 1] - g.out_offset[z] > hub) continue;
+      for (edge_id f = g.out_offset[z]; f < g.out_offset[z + 1]; ++f)
+        heap.add(g.outs[f], d);
+    }
+  };
+
+  std::vector<node_id> by_degree = order_degree(g), order;
+  std::vector<bool> placed(g.n + 1);
+  size_t next_seed = 0;
+  while (order.size() < g.n) {
+    node_id v = heap.top();
+    // no node is related to the window, start from the next hub
+    if (!v) {
+      while (placed[by_degree[next_seed]]) ++next_seed;
+      v = by_degree[next_seed];
+    }
+    placed[v] = true;
+    heap.remove(v);
+    order.push_back(v);
+    touch(v, 1);
+    if (order.size() > window) touch(order[order.size() - 1 - window], -1);
+  }
+  return order;
+}
+
+void relabel(edge_list& edges, const std::vector<node_id>& id, bool dird) {
+  for (auto& [u, v] : edges) {
+    u = id[u], v = id[v];
+    if (!dird && u > v) std::swap(u, v);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    log_fatal("missing argument <data_path>\nusage:\n%s", help);
+    return -1;
+  }
+
+  std::string method = "degree";
+  size_t window = 5;
+  for (int i = 2; i < argc; ++i) {
+    if (strcmp(argv[i], "--order") == 0) {
+      method = argv[++i];
+    } else if (strcmp(argv[i], "--window") == 0) {
+      window = std::max(atoi(argv[++i]), 1);
+    } else {
+      log_fatal("unknown option %s\nusage:\n%s", argv[i], help);
+      return -1;
+    }
+  }
+
+  auto [n, m, dird] = load_file<graph_meta>(filepath("meta"));
+  auto edges = load_file<edge_list>(filepath("graph"));
+  adjacency g(n, edges, dird);
+
+  log_info("ordering %zu nodes by %s", (size_t)n, method.c_str());
+  std::vector<node_id> order;
+  if (method == "degree") {
+    order = order_degree(g);
+  } else if (method == "bfs") {
+    order = order_bfs(g, order_degree(g), [](node_id, node_id) {
+      return false;
+    });
+  } else if (method == "rcm") {
+    order = order_rcm(g);
+  } else if (method == "gorder") {
+    order = order_gorder(g, window);
+  } else {
+    log_fatal("unknown order %s\nusage:\n%s", method.c_str(), help);
+    return -1;
+  }
+
+  // new id of every node, and the original id of every new one; a former
+  // mapping is composed so that ids always translate to the input ones
+  std::vector<node_id> id(n + 1, 0), mapping(n + 1, 0);
+  std::vector<node_id> former(n + 1);
+  std::iota(former.begin(), former.end(), 0);
+  if (file_exists(filepath("mapping")))
+    former = load_file<std::vector<node_id>>(filepath("mapping"));
+  for (node_id i = 0; i < n; ++i) {
+    id[order[i]] = i + 1;
+    mapping[i + 1] = former[order[i]];
+  }
+
+  relabel(edges, id, dird);
+  std::sort(edges.begin(), edges.end());
+  save_file(filepath("graph"), edges);
+  for (const char* file : {"graph_base", "edges_ins", "edges_del"}) {
+    if (!file_exists(filepath(file))) continue;
+    auto part = load_file<edge_list>(filepath(file));
+    relabel(part, id, dird);
+    save_file(filepath(file), part);
+  }
+
+  std::string folder = filepath("workloads");
+  if (DIR* dir = opendir(folder.c_str())) {
+    while (dirent* ent = readdir(dir)) {
+      if (ent->d_name[0] == '.') continue;
+      std::string path = file_path(2, folder.c_str(), ent->d_name);
+      auto w = load_file<std::vector<update>>(path);
+      // the second node of a query is k, or 0 for a target, and the first
+      // one of a seed-set query is the index of its set
+      for (auto& [o, u, v] : w) {
+        if (o != '*') u = id[u];
+        if (o == '=' || o == '+' || o == '-') v = id[v];
+      }
+      save_file(path, w);
+    }
+    closedir(dir);
+  }
+
+  folder = filepath("seeds");
+  if (DIR* dir = opendir(folder.c_str())) {
+    while (dirent* ent = readdir(dir)) {
+      if (ent->d_name[0] == '.') continue;
+      std::string path = file_path(2, folder.c_str(), ent->d_name);
+      auto seeds = load_file<std::vector<seed_set>>(path);
+      for (seed_set& ss : seeds)
+        for (auto& [s, x] : ss) s = id[s];
+      save_file(path, seeds);
+    }
+    closedir(dir);
+  }
+
+  save_file(filepath("mapping"), mapping);
+
+  return 0;
+}
@@ -1,40 +1,298 @@
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
-#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
 #include <string>
 #include <utility>
+#include <vector>
 #include "apps/io/file.hpp"
 #include "apps/types.hpp"
-#include "lib/random.hpp"
+#include "lib/parallel.hpp"
 
 constexpr char help[] =
   "generate <data_path> [options]\n"
   "options:\n"
+  "  --model <er|rmat|ba|chunglu>\n"
   "  --n_nodes <number of nodes>\n"
-  "  --p_edges <probability an edge will occur>\n"
+  "  --p_edges <probability an edge will occur, er>\n"
+  "  --degree <average degree, rmat|ba|chunglu>\n"
+  "  --exponent <exponent of the power-law degrees, chunglu>\n"
+  "  --rmat <probabilities a,b,c of the quadrants, rmat>\n"
+  "  --seed <random seed>\n"
+  "  --threads <number of worker threads>\n"
   "  --directed|undirected\n";
 
 #define filepath(file) (file_path(2, argv[1], file))
 
+uint64_t splitmix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// random numbers of a block of work, determined by the seed and the block
+// alone so that the output does not depend on the scheduling of threads
+class block_random {
+private:
+  std::mt19937_64 _gen;
+
+public:
+  block_random(uint64_t seed, uint64_t tag, uint64_t block) :
+    _gen(splitmix(seed ^ splitmix(tag ^ splitmix(block)))) { }
+
+  std::mt19937_64& engine() noexcept {
+    return _gen;
+  }
+
+  // in [0, 1)
+  double uniformf() {
+    return 0x1.0p-53 * (_gen() >> 11);
+  }
+
+  // number of trials up to the first success
+  uint64_t geometric(double p) {
+    if (p >= 1) return 1;
+    double u = 1 - uniformf();
+    return (uint64_t)ceil(std::log(u) / std::log(1 - p));
+  }
+};
+
+constexpr node_id block_nodes = 1 << 14;
+
+// source nodes of a block
+std::pair<node_id, node_id> block_range(size_t b, node_id n) {
+  node_id lo = b * block_nodes + 1;
+  return {lo, std::min<node_id>(n, lo - 1 + block_nodes)};
+}
+
+// generate the edges of blocks 0, ..., n_blocks - 1 in parallel, and write
+// each block in order as soon as it and the blocks before it are done; a
+// worker starts a block only while the finished blocks waiting to be written
+// hold less than max_bytes, or when its block is the next to write
+template <typename G>
+void stream_edges(vector_writer<edge>& out, size_t n_blocks, G gen) {
+  constexpr size_t max_bytes = 256 << 20;
+  std::mutex lock;
+  std::condition_variable written;
+  std::map<size_t, edge_list> done;
+  size_t next = 0, held = 0;
+  parallel_for(n_blocks, [&](size_t b) {
+    {
+      std::unique_lock<std::mutex> lk(lock);
+      written.wait(lk, [&]() { return held < max_bytes || b == next; });
+    }
+    edge_list edges;
+    gen(b, edges);
+    std::lock_guard<std::mutex> lk(lock);
+    held += edges.size() * sizeof(edge);
+    done.emplace(b, std::move(edges));
+    if (done.begin()->first != next) return;
+    for (auto it = done.begin(); it != done.end() && it->first == next;
+      it = done.erase(it), ++next)
+    {
+      out.write(it->second);
+      held -= it->second.size() * sizeof(edge);
+    }
+    log_info("%zu / %zu block(s), %zu edge(s)", next, n_blocks, out.size());
+    written.notify_all();
+  });
+}
+
+void dedup(edge_list& edges, size_t from) {
+  std::sort(edges.begin() + from, edges.end());
+  edges.erase(std::unique(edges.begin() + from, edges.end()), edges.end());
+}
+
+// each pair independently with probability p
+void gen_er(vector_writer<edge>& out, uint64_t seed, node_id n, double p,
+  bool dird)
+{
+  if (p <= 0) return;
+  stream_edges(out, (n + block_nodes - 1) / block_nodes,
+    [=](size_t b, edge_list& edges) {
+      block_random rnd(seed, 0, b);
+      auto [lo, hi] = block_range(b, n);
+      for (node_id u = lo; u <= hi; ++u) {
+        for (uint64_t v = dird ? 0 : u; ; ) {
+          v += rnd.geometric(p);
+          if (v > n) break;
+          edges.emplace_back(u, v);
+        }
+      }
+    });
+}
+
+// chung-lu graph with expected degrees w_i proportional to i^(-1/(gamma-1)),
+// sampled per source by skipping over the decreasing probabilities
+void gen_chunglu(vector_writer<edge>& out, uint64_t seed, node_id n,
+  double degree, double gamma, bool dird)
+{
+  double beta = 1 / (gamma - 1), sum = 0;
+  for (node_id i = 1; i <= n; ++i) sum += pow(i, -beta);
+  double c = degree * n / sum, total = degree * n;
+  auto w = [c, beta](node_id i) { return c * pow(i, -beta); };
+
+  stream_edges(out, (n + block_nodes - 1) / block_nodes,
+    [=](size_t b, edge_list& edges) {
+      block_random rnd(seed, 1, b);
+      auto [lo, hi] = block_range(b, n);
+      for (node_id u = lo; u <= hi; ++u) {
+        double wu = w(u);
+        uint64_t v = dird ? 1 : u + 1;
+        double p = std::min(1.0, wu * w(v) / total);
+        while (v <= n && p > 0) {
+          if (p < 1) v += rnd.geometric(p) - 1;
+          if (v > n) break;
+          double q = std::min(1.0, wu * w(v) / total);
+          if (rnd.uniformf() < q / p && v != u) edges.emplace_back(u, v);
+          p = q;
+          ++v;
+        }
+      }
+    });
+}
+
+// preferential attachment, node u links k times to an endpoint picked
+// uniformly among all endpoints of earlier edges; the pick of every edge is
+// a hash of its index, so targets are resolved without the edge list
+void gen_ba(vector_writer<edge>& out, uint64_t seed, node_id n,
+  double degree, bool dird)
+{
+  uint64_t k = std::max<uint64_t>(1, llround(dird ? degree : degree / 2));
+  auto target = [seed, k](uint64_t e) -> node_id {
+    while (true) {
+      // positions 0, ..., 2e, the even ones being sources
+      uint64_t r = (unsigned __int128)splitmix(seed ^ splitmix(e)) *
+        (2 * e + 1) >> 64;
+      if (r % 2 == 0) return r / 2 / k + 1;
+      e = r / 2;
+    }
+  };
+
+  stream_edges(out, (n + block_nodes - 1) / block_nodes,
+    [=](size_t b, edge_list& edges) {
+      auto [lo, hi] = block_range(b, n);
+      for (node_id u = lo; u <= hi; ++u) {
+        size_t from = edges.size();
+        for (uint64_t e = (u - 1) * k; e < u * k; ++e) {
+          node_id v = target(e);
+          if (v == u) continue;
+          edges.emplace_back(dird ? u : v, dird ? v : u);
+        }
+        dedup(edges, from);
+      }
+    });
+}
+
+// r-mat graph of n * degree edge draws on 2^scale nodes, the edge matrix is
+// split by rows with binomial edge counts until a block of rows is small
+// enough; draws out of range, self loops and duplicates are dropped, and
+// undirected graphs keep the upper triangle
+void gen_rmat(vector_writer<edge>& out, uint64_t seed, node_id n,
+  double degree, double a, double b, double c, bool dird)
+{
+  double d = 1 - a - b - c;
+  unsigned scale = 0;
+  while (((uint64_t)1 << scale) < n) ++scale;
+  constexpr uint64_t max_draws = 1 << 20;
+
+  // (level, row prefix, draws) of every block of rows, in row order
+  struct block { unsigned level; uint64_t prefix, draws; };
+  std::vector<block> blocks;
+  std::vector<block> stack { {0, 0, (uint64_t)llround(degree * n)} };
+  while (!stack.empty()) {
+    block x = stack.back();
+    stack.pop_back();
+    if (x.draws == 0 || (x.prefix << (scale - x.level)) >= n) continue;
+    if (x.draws <= max_draws || x.level == scale) {
+      blocks.push_back(x);
+      continue;
+    }
+    block_random rnd(seed, 2 + x.level, x.prefix);
+    uint64_t top = std::binomial_distribution<uint64_t>(x.draws, a + b)(
+      rnd.engine());
+    stack.push_back({x.level + 1, 2 * x.prefix + 1, x.draws - top});
+    stack.push_back({x.level + 1, 2 * x.prefix, top});
+  }
+
+  stream_edges(out, blocks.size(), [&](size_t i, edge_list& edges) {
+    auto [level, prefix, draws] = blocks[i];
+    block_random rnd(seed, 2 + scale + 1, i);
+    for (uint64_t j = 0; j < draws; ++j) {
+      uint64_t u = 0, v = 0;
+      for (unsigned l = 0; l < scale; ++l) {
+        double r = rnd.uniformf();
+        bool row, col;
+        if (l < level) {
+          // the row is fixed by the block
+          row = prefix >> (level - 1 - l) & 1;
+          col = row ? r < d / (c + d) : r < b / (a + b);
+        } else {
+          row = r >= a + b;
+          col = row ? r >= a + b + c : r >= a;
+        }
+        u = 2 * u + row;
+        v = 2 * v + col;
+      }
+      ++u, ++v;
+      if (u > n || v > n || u == v || (!dird && u > v)) continue;
+      edges.emplace_back(u, v);
+    }
+    dedup(edges, 0);
+  });
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     log_fatal("missing argument <data_path>\nusage:\n%s", help);
     return -1;
   }
 
+  std::string model = "er";
   node_id n = 0;
-  double p = 0.0;
+  double p = 0.0, degree = 10, gamma = 2.5;
+  double a = 0.57, b = 0.19, c = 0.19;
+  uint64_t seed = 0;
   bool dird = true;
   for (int i = 2; i < argc; ++i) {
-    if (strcmp(argv[i], "--n_nodes") == 0) {
-      n = atoi(argv[++i]);
+    if (strcmp(argv[i], "--model") == 0) {
+      model = argv[++i];
+    } else if (strcmp(argv[i], "--n_nodes") == 0) {
+      n = atoll(argv[++i]);
     } else if (strcmp(argv[i], "--p_edges") == 0) {
       p = atof(argv[++i]);
       if (p < 0 || p > 1) {
         log_fatal("invalid p_edges, must be in [0,1]");
         return -1;
       }
+    } else if (strcmp(argv[i], "--degree") == 0) {
+      degree = atof(argv[++i]);
+      if (degree <= 0) {
+        log_fatal("invalid degree, must be positive");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--exponent") == 0) {
+      gamma = atof(argv[++i]);
+      if (gamma <= 1) {
+        log_fatal("invalid exponent, must be greater than 1");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--rmat") == 0) {
+      if (sscanf(argv[++i], "%lf,%lf,%lf", &a, &b, &c) != 3 ||
+        a < 0 || b < 0 || c < 0 || a + b + c > 1)
+      {
+        log_fatal("invalid rmat, must be a,b,c with a + b + c <= 1");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      parallel_threads = atoi(argv[++i]);
     } else if (strcmp(argv[i], "--directed") == 0) {
       dird = true;
     } else if (strcmp(argv[i], "--undirected") == 0) {
@@ -44,22 +302,26 @@ int main(int argc, char *argv[]) {
       return -1;
     }
   }
-  edge_list edges;
-  if (p > 0) {
-    for (node_id u = 1; u <= n; ++u) {
-      for (node_id v = dird ? 0 : u; ; ) {
-        v += rand_geometric(p);
-        if (v > n) break;
-        edges.push_back(std::make_pair(u, v));
-      }
-    }
+
+  vector_writer<edge> out(filepath("graph"));
+  if (model == "er") {
+    gen_er(out, seed, n, p, dird);
+  } else if (model == "chunglu") {
+    gen_chunglu(out, seed, n, degree, gamma, dird);
+  } else if (model == "ba") {
+    gen_ba(out, seed, n, degree, dird);
+  } else if (model == "rmat") {
+    gen_rmat(out, seed, n, degree, a, b, c, dird);
+  } else {
+    log_fatal("unknown model %s\nusage:\n%s", model.c_str(), help);
+    return -1;
   }
-  edge_id m = edges.size();
+  edge_id m = out.size();
+  out.close();
 
   log_info("graph generated, n = %zu, m = %zu", (size_t)n, (size_t)m);
 
   save_file(filepath("meta"), std::make_tuple(n, m, dird));
-  save_file(filepath("graph"), edges);
 
   return 0;
-}
\ No newline at end of file
+}
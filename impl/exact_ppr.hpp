@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
+#include "time/counter.hpp"
 #include "time/timer.hpp"
 #include "fora_interface.hpp"
 #include "graph.hpp"
@@ -25,14 +26,16 @@ private:
     std::fill(__rsd.begin(), __rsd.end(), 0);
   }
 
-  void _evaluate(node_id s) {
+  void _evaluate(const seed_set& seeds) {
     static uniqueue *q = new uniqueue(_g->num_nodes() + 1);
     static uniqueue *q_next = new uniqueue(_g->num_nodes() + 1);
     Timer tmr(TIMER::EVALUATE);
     Timer tmr2(TIMER::PUSH);
 
-    __rsd[s] = 1.0;
-    q->push(s);
+    for (auto [s, x] : seeds) {
+      __rsd[s] += x;
+      q->push(s);
+    }
     for (size_t i = 0; i < _round; ++i) {
       while (!q->empty()) {
         node_id u = q->pop();
@@ -40,6 +43,8 @@ private:
           __rsv[u] += __rsd[u];
           __rsd[u] = 0;
         } else {
+          count_work(PUSH, 1);
+          count_work(EDGE_SCAN, _g->get_degree(u));
           __rsv[u] += _alpha * __rsd[u];
           double detr = (1 - _alpha) * __rsd[u] / _g->get_degree(u);
           __rsd[u] = 0;
@@ -55,6 +60,41 @@ private:
     while (!q->empty()) q->pop();
   }
 
+  // backward push over in-edges, __rsv[s] being the ppr of t from s; a walk
+  // reaching a dangling node stops there, not only with alpha
+  void _evaluate_target(node_id t) {
+    static uniqueue *q = new uniqueue(_g->num_nodes() + 1);
+    static uniqueue *q_next = new uniqueue(_g->num_nodes() + 1);
+    Timer tmr(TIMER::EVALUATE);
+    Timer tmr2(TIMER::PUSH);
+
+    _g->track_in_edges();
+    __rsd[t] = 1.0;
+    q->push(t);
+    for (size_t i = 0; i < _round; ++i) {
+      while (!q->empty()) {
+        node_id v = q->pop();
+        bool dangling = _g->is_dangling_node(v);
+        count_work(PUSH, 1);
+        count_work(EDGE_SCAN, _g->get_in_degree(v));
+        __rsv[v] += dangling ? __rsd[v] : _alpha * __rsd[v];
+        double detr = (1 - _alpha) * __rsd[v] / (dangling ? _alpha : 1.);
+        __rsd[v] = 0;
+        for (node_id u : _g->get_in_neighbourhood(v)) {
+          __rsd[u] += detr / _g->get_degree(u);
+          q_next->push(u);
+        }
+      }
+      std::swap(q, q_next);
+    }
+    assert(q_next->empty());
+    while (!q->empty()) q->pop();
+  }
+
+  void _evaluate(node_id s) {
+    _evaluate(seed_set{{s, 1.}});
+  }
+
   void _output_full(fora_impl_full::outputer output) {
     Timer tmr(TIMER::OUTPUT);
     output(__rsv);
@@ -79,19 +119,21 @@ public:
   template <typename C>
   exact_ppr(bool is_dird, node_id n, const edge_list& edges, C config) :
     _round(config.round), _alpha(config.alpha),
-    _is_dird(is_dird), _g(new graph(n)),
-    __rsv(n + 1), __rsd(n + 1)
-  {
-    for (auto [u, v] : edges) {
-      _g->insert_edge(u, v);
-      if (!is_dird && u != v) _g->insert_edge(v, u);
-    }
+    _is_dird(is_dird), _g(new graph(n, edges, is_dird)),
+    __rsv(n + 1), __rsd(n + 1) { }
+
+  ~exact_ppr() {
+    delete _g;
   }
 
   econfigs experiment_configs() {
     return econfigs { _alpha, pow(1 - _alpha, _round), 0, 0 };
   }
 
+  edge_list snapshot() {
+    return _g->edges(_is_dird);
+  }
+
   void evaluate_full(node_id s, fora_impl_full::outputer output) {
     _clear();
     _evaluate(s);
@@ -104,6 +146,51 @@ public:
     _output_topk(output, k);
   }
 
+  void evaluate_full(const seed_set& seeds, fora_impl_full::outputer output) {
+    _clear();
+    _evaluate(seeds);
+    _output_full(output);
+  }
+
+  void evaluate_topk(const seed_set& seeds, node_id k,
+    fora_impl_topk::outputer output)
+  {
+    _clear();
+    _evaluate(seeds);
+    _output_topk(output, k);
+  }
+
+  void evaluate_target(node_id t, fora_impl_target::outputer output) {
+    _clear();
+    _evaluate_target(t);
+    _output_full(output);
+  }
+
+  double evaluate_pair(node_id s, node_id t) {
+    _clear();
+    _evaluate(s);
+    return __rsv[t];
+  }
+
+  void evaluate_batch(std::span<const node_id> sources,
+    fora_impl_batch::outputer output)
+  {
+    for (node_id s : sources) {
+      _clear();
+      _evaluate(s);
+      Timer tmr(TIMER::OUTPUT);
+      output(s, __rsv);
+    }
+  }
+
+  // the rounds share their vectors, so sources are answered one by one
+  size_t evaluate_all(std::span<const node_id> sources, size_t,
+    fora_impl_batch::outputer output)
+  {
+    evaluate_batch(sources, output);
+    return 1;
+  }
+
   void insert_edge(node_id u, node_id v) {
     Timer tmr(TIMER::UPDATE);
     std::optional<edge_sno> esno = _g->insert_edge(u, v);
@@ -12,7 +12,8 @@
 template <typename H>
 class fora :
   public fora_interface,
-  public fora_impl_full, public fora_impl_topk
+  public fora_impl_full, public fora_impl_topk, public fora_impl_target,
+  public fora_impl_batch
 {
 private:
   const bool _is_dird;
@@ -22,19 +23,24 @@ private:
 public:
   template <typename C>
   fora(bool is_dird, node_id n, const edge_list& edges, C config) :
-    _is_dird(is_dird), _g(new graph(n)), _h(nullptr)
+    _is_dird(is_dird), _g(new graph(n, edges, is_dird)), _h(nullptr)
   {
-    for (auto [u, v] : edges) {
-      _g->insert_edge(u, v);
-      if (!is_dird && u != v) _g->insert_edge(v, u);
-    }
     *const_cast<H**>(&_h) = new H(_g, is_dird, config);
   }
 
+  ~fora() {
+    delete _h;
+    delete _g;
+  }
+
   econfigs experiment_configs() {
     return econfigs { _h->alpha, _h->eps, _h->det, _h->pf };
   }
 
+  edge_list snapshot() {
+    return _g->edges(_is_dird);
+  }
+
 
   void evaluate_full(node_id s, fora_impl_full::outputer output) {
     fora_impl_full::evaluate(_g, _h, s, output);
@@ -44,6 +50,36 @@ public:
     fora_impl_topk::evaluate(_g, _h, s, k, output);
   }
 
+  void evaluate_full(const seed_set& seeds, fora_impl_full::outputer output) {
+    fora_impl_full::evaluate(_g, _h, seeds, output);
+  }
+
+  void evaluate_topk(const seed_set& seeds, node_id k,
+    fora_impl_topk::outputer output)
+  {
+    fora_impl_topk::evaluate(_g, _h, seeds, k, output);
+  }
+
+  void evaluate_target(node_id t, fora_impl_target::outputer output) {
+    fora_impl_target::evaluate(_g, _h, t, output);
+  }
+
+  double evaluate_pair(node_id s, node_id t) {
+    return fora_impl_target::evaluate_pair(_g, _h, s, t);
+  }
+
+  void evaluate_batch(std::span<const node_id> sources,
+    fora_impl_batch::outputer output)
+  {
+    fora_impl_batch::evaluate(_g, _h, sources, output);
+  }
+
+  size_t evaluate_all(std::span<const node_id> sources, size_t max_bytes,
+    fora_impl_batch::outputer output)
+  {
+    return fora_impl_batch::evaluate_all(_g, _h, sources, max_bytes, output);
+  }
+
   void insert_edge(node_id u, node_id v) {
     Timer tmr(TIMER::UPDATE);
     std::optional<edge_sno> esno = _g->insert_edge(u, v);
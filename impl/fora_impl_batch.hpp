@@ -0,0 +1,257 @@
+#pragma once
+
+#include <assert.h>
+#include "log/log.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "time/counter.hpp"
+#include "time/timer.hpp"
+#include "lib/parallel.hpp"
+#include "graph.hpp"
+#include "uniqueue.hpp"
+
+// full queries of several sources at once: the residues and reserves of a
+// node are contiguous lanes, one per source, so a push scans the adjacency
+// once for every lane, and the walks drawn at a node serve every lane; the
+// scratch vectors are per thread, so that the lanes of a job run in parallel
+class fora_impl_batch {
+public:
+  // sources of one pass, wider batches are split
+  static constexpr size_t max_lanes = 16;
+
+private:
+  using ppr_vec = std::vector<double>;
+
+  // a node is pushed once any lane exceeds its threshold, and then in all
+  // lanes, which stays exact and costs no further scans
+  template <typename H>
+  void _forward_push(graph* _g, H* _h, ppr_vec& rsv, ppr_vec& rsd,
+    std::span<const node_id> sources)
+  {
+    static thread_local uniqueue queue(_g->num_nodes() + 1);
+    Timer tmr(TIMER::PUSH);
+
+    const size_t k = sources.size();
+    double rmax = _h->rmax(_h->det);
+    auto active = [&](node_id v) {
+      double lim = rmax * _g->get_degree(v);
+      for (size_t j = 0; j < k; ++j)
+        if (rsd[v * k + j] >= lim) return true;
+      return false;
+    };
+    for (size_t j = 0; j < k; ++j) {
+      node_id s = sources[j];
+      if (_g->is_dangling_node(s)) rsv[s * k + j] += 1.0;
+      else {
+        rsd[s * k + j] += 1.0;
+        queue.push(s);
+      }
+    }
+
+    double detr[max_lanes];
+    while (!queue.empty()) {
+      node_id u = queue.pop();
+      if (!active(u)) continue;
+      // dangling node cannot be in queue
+      double* ru = &rsd[u * k];
+      double* pu = &rsv[u * k];
+      for (size_t j = 0; j < k; ++j) {
+        pu[j] += _h->alpha * ru[j];
+        detr[j] = (1 - _h->alpha) * ru[j] / _g->get_degree(u);
+        ru[j] = 0;
+      }
+      log_trace("on node %zu", (size_t)u);
+      count_work(PUSH, 1);
+      count_work(EDGE_SCAN, _g->get_degree(u));
+
+      for (node_id v : _g->get_neighbourhood(u)) {
+        if (_g->is_dangling_node(v)) {
+          double* pv = &rsv[v * k];
+          for (size_t j = 0; j < k; ++j) pv[j] += detr[j];
+        } else {
+          double* rv = &rsd[v * k];
+          for (size_t j = 0; j < k; ++j) rv[j] += detr[j];
+          if (active(v)) queue.push(v);
+        }
+      }
+    }
+  }
+
+  // the largest residue of a node over lanes bounds the error its walks
+  // bring to any lane
+  template <typename H>
+  void _adapt(graph* _g, H* _h, const ppr_vec& rsd, size_t k, double det) {
+    static ppr_vec rmx(_g->num_nodes() + 1);
+    Timer tmr(TIMER::ADAPT);
+    for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v) {
+      rmx[v] = 0;
+      for (size_t j = 0; j < k; ++j)
+        rmx[v] = std::max(rmx[v], fabs(rsd[v * k + j]));
+    }
+    _h->adapt(rmx, det);
+  }
+
+  // a push leaves less than rmax * deg(v) at any node v, so the index
+  // adapted to these residues serves every source without adapting again
+  template <typename H>
+  void _adapt_all(graph* _g, H* _h, double det) {
+    static ppr_vec rmx;
+    Timer tmr(TIMER::ADAPT);
+    double rmax = _h->rmax(det);
+    rmx.assign(_g->num_nodes() + 1, 0);
+    for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v)
+      if (!_g->is_dangling_node(v)) rmx[v] = rmax * _g->get_degree(v);
+    _h->adapt(rmx, det);
+  }
+
+  // sources in the order a breadth-first search from them meets them, so
+  // that the lanes of a pass push over much the same nodes
+  static std::vector<node_id> _locality_order(graph* _g,
+    std::span<const node_id> sources)
+  {
+    std::vector<char> wanted(_g->num_nodes() + 1), seen(_g->num_nodes() + 1);
+    for (node_id s : sources) wanted[s] = 1;
+    std::vector<node_id> order, queue;
+    for (node_id r : sources) {
+      if (seen[r]) continue;
+      seen[r] = 1;
+      queue.assign(1, r);
+      for (size_t i = 0; i < queue.size(); ++i) {
+        node_id u = queue[i];
+        if (wanted[u]) order.push_back(u), wanted[u] = 0;
+        for (node_id v : _g->get_neighbourhood(u))
+          if (!seen[v]) seen[v] = 1, queue.push_back(v);
+      }
+    }
+    return order;
+  }
+
+  template <typename H>
+  void _combine(graph* _g, H* _h, ppr_vec& rsv, const ppr_vec& rsd,
+    size_t k, double det)
+  {
+    Timer tmr(TIMER::REFINE);
+    record_sno c[max_lanes];
+    double wgh[max_lanes];
+    for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v) {
+      const double* rv = &rsd[v * k];
+      if (_g->is_dangling_node(v)) {
+        for (size_t j = 0; j < k; ++j) rsv[v * k + j] += rv[j];
+        continue;
+      }
+      record_sno cmax = 0;
+      for (size_t j = 0; j < k; ++j) {
+        if (rv[j] == 0) {
+          c[j] = 0;
+          continue;
+        }
+        count_work(RESIDUE, rv[j]);
+        rsv[v * k + j] += _h->alpha * rv[j];
+        c[j] = _h->num_samples(v, fabs(rv[j]), det);
+        wgh[j] = (1 - _h->alpha) * rv[j] / c[j];
+        cmax = std::max(cmax, c[j]);
+      }
+      // lane j takes the first c[j] walks
+      count_work(SAMPLE, cmax);
+      for (record_sno i = 0; i < cmax; ++i) {
+        double* pt = &rsv[_h->get(v, i) * k];
+        for (size_t j = 0; j < k; ++j)
+          if (i < c[j]) pt[j] += wgh[j];
+      }
+    }
+  }
+
+public:
+  using outputer =
+    std::function<void(node_id, const std::vector<double>&)>;
+
+private:
+  void _output(outputer output, const ppr_vec& rsv,
+    std::span<const node_id> sources)
+  {
+    static thread_local ppr_vec ppr;
+    Timer tmr(TIMER::OUTPUT);
+    const size_t k = sources.size();
+    ppr.resize(rsv.size() / k);
+    for (size_t j = 0; j < k; ++j) {
+      for (node_id v = 0; v < ppr.size(); ++v) ppr[v] = rsv[v * k + j];
+      output(sources[j], ppr);
+    }
+  }
+
+  // one pass of at most max_lanes sources, adapting the index unless it
+  // has been adapted for every source already
+  template <typename H>
+  void _evaluate(graph* _g, H* _h, std::span<const node_id> batch,
+    outputer output, bool adapt)
+  {
+    static thread_local ppr_vec rsv, rsd;
+    size_t k = batch.size();
+    rsv.assign((_g->num_nodes() + 1) * k, 0);
+    rsd.assign((_g->num_nodes() + 1) * k, 0);
+    {
+      Timer tmr(TIMER::EVALUATE);
+      log_debug("forward pushing %zu source(s)", k);
+      _forward_push(_g, _h, rsv, rsd, batch);
+      if (adapt) {
+        log_debug("adjusting indecies");
+        _adapt(_g, _h, rsd, k, _h->det);
+      }
+      log_debug("refining estimation");
+      _combine(_g, _h, rsv, rsd, k, _h->det);
+    }
+    _output(output, rsv, batch);
+  }
+
+protected:
+  template <typename H>
+  void evaluate(graph* _g, H* _h, std::span<const node_id> sources,
+    outputer output)
+  {
+    for (size_t b = 0; b < sources.size(); b += max_lanes)
+      _evaluate(_g, _h, sources.subspan(b,
+        std::min(max_lanes, sources.size() - b)), output, true);
+  }
+
+  // a worker keeps dense residues and reserves of its lanes, 16 bytes per
+  // node and lane, and a dense output of 8 bytes per node; within max_bytes
+  // as many workers as possible run, then as many lanes as fit
+  static std::pair<size_t, size_t> job_shape(size_t n, size_t max_bytes) {
+    size_t per_lane = 2 * sizeof(double) * (n + 1);
+    size_t per_worker = sizeof(double) * (n + 1);
+    size_t workers = std::max<size_t>(1, std::min(num_workers(),
+      max_bytes / (per_worker + per_lane)));
+    size_t lanes = std::clamp<size_t>(
+      (max_bytes / workers - std::min(max_bytes / workers, per_worker)) /
+      per_lane, 1, max_lanes);
+    return { workers, lanes };
+  }
+
+  // every source of a job, passes running on the workers, which take the
+  // next pass once done with theirs; the index is only read meanwhile, so
+  // output is called concurrently and must be thread-safe; returns the
+  // number of workers
+  template <typename H>
+  size_t evaluate_all(graph* _g, H* _h, std::span<const node_id> sources,
+    size_t max_bytes, outputer output)
+  {
+    log_debug("adjusting indecies for all sources");
+    _adapt_all(_g, _h, _h->det);
+    std::vector<node_id> order = _locality_order(_g, sources);
+    std::span<const node_id> all(order);
+    auto [workers, lanes] = job_shape(_g->num_nodes(), max_bytes);
+    size_t passes = (order.size() + lanes - 1) / lanes;
+    log_info("answering %zu source(s) in %zu pass(es) of %zu lane(s) on "
+      "%zu worker(s)", order.size(), passes, lanes, workers);
+    parallel_for(passes, [&, lanes](size_t b) {
+      size_t first = b * lanes;
+      _evaluate(_g, _h, all.subspan(first,
+        std::min(lanes, order.size() - first)), output, false);
+    }, 1, workers);
+    return std::min(workers, passes);
+  }
+};
@@ -3,9 +3,12 @@
 #include <assert.h>
 #include "log/log.h"
 #include <algorithm>
+#include <cmath>
 #include <vector>
+#include "time/counter.hpp"
 #include "time/timer.hpp"
 #include "graph.hpp"
+#include "hub_ppr.hpp"
 #include "uniqueue.hpp"
 
 class fora_impl_full {
@@ -13,33 +16,48 @@ private:
   using ppr_vec = std::vector<double>;
 
   template <typename H>
-  void _forward_push(graph* _g, H* _h, ppr_vec& rsv, ppr_vec& rsd, node_id s)
+  void _forward_push(graph* _g, H* _h, ppr_vec& rsv, ppr_vec& rsd,
+    const seed_set& seeds)
   {
     static uniqueue queue(_g->num_nodes() + 1);
     Timer tmr(TIMER::PUSH);
 
     double rmax = _h->rmax(_h->det);
-    if (_g->is_dangling_node(s)) rsv[s] = 1.0;
-    else {
-      rsd[s] = 1.0;
-      if (rsd[s] >= rmax * _g->get_degree(s)) queue.push(s);
-    }
+    auto spread = [&](node_id v, double r) {
+      // push method will not be invoked at dangling node
+      if (_g->is_dangling_node(v)) rsv[v] += r;
+      else {
+        rsd[v] += r;
+        if (rsd[v] >= rmax * _g->get_degree(v)) queue.push(v);
+      }
+    };
+    // the residue starts as the preference vector
+    for (auto [s, x] : seeds) spread(s, x);
     while (!queue.empty()) {
       node_id u = queue.pop();
+      if constexpr (hub_indexed<H>) {
+        const hub_ppr* hub = _h->hub(u);
+        // absorb the precomputed push from the hub when it is cheaper than
+        // the pushes the residue could trigger, at most rsd / (alpha * rmax)
+        if (hub && hub->size() * _h->alpha * rmax < rsd[u]) {
+          double r = rsd[u];
+          log_trace("on hub %zu, rsd = %e", (size_t)u, r);
+          count_work(HUB_ABSORB, 1);
+          rsd[u] = 0;
+          for (auto [v, x] : hub->rsv) rsv[v] += r * x;
+          for (auto [v, x] : hub->rsd) spread(v, r * x);
+          continue;
+        }
+      }
       rsv[u] += _h->alpha * rsd[u];
       // dangling node cannot be in queue
       double detr = (1 - _h->alpha) * rsd[u] / _g->get_degree(u);
       log_trace("on node %zu, rsd = %e, inc = %e", (size_t)u, rsd[u], detr);
+      count_work(PUSH, 1);
+      count_work(EDGE_SCAN, _g->get_degree(u));
       rsd[u] = 0;
 
-      for (node_id v : _g->get_neighbourhood(u)) {
-        // push method will not be invoked at dangling node
-        if (_g->is_dangling_node(v)) rsv[v] += detr;
-        else {
-          rsd[v] += detr;
-          if (rsd[v] >= rmax * _g->get_degree(v)) queue.push(v);
-        }
-      }
+      for (node_id v : _g->get_neighbourhood(u)) spread(v, detr);
     }
   }
 
@@ -54,11 +72,14 @@ private:
   {
     Timer tmr(TIMER::REFINE);
     for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v) {
+      count_work(RESIDUE, fabs(rsd[v]));
       if (_g->is_dangling_node(v)) rsv[v] += rsd[v];
       else {
         rsv[v] += _h->alpha * rsd[v];
-        record_sno c = _h->num_samples(v, rsd[v], det);
+        // residues absorbed from hubs may be negative
+        record_sno c = _h->num_samples(v, fabs(rsd[v]), det);
         double wgh = (1 - _h->alpha) * rsd[v] / c;
+        count_work(SAMPLE, c);
         for (record_sno i = 0; i < c; ++i)
           rsv[_h->get(v, i)] += wgh;
       }
@@ -67,11 +88,11 @@ private:
 
   template <typename H>
   void _evaluate(graph* _g, H* _h,
-    node_id s, ppr_vec& rsv, ppr_vec& rsd)
+    const seed_set& seeds, ppr_vec& rsv, ppr_vec& rsd)
   {
     Timer tmr(TIMER::EVALUATE);
     log_debug("forward pushing");
-    _forward_push(_g, _h, rsv, rsd, s);
+    _forward_push(_g, _h, rsv, rsd, seeds);
     log_debug("adjusting indecies");
     _adapt(_h, rsd, _h->det);
     log_debug("refining estimation");
@@ -89,13 +110,18 @@ private:
 
 protected:
   template <typename H>
-  void evaluate(graph* _g, H* _h, node_id s, outputer output) {
+  void evaluate(graph* _g, H* _h, const seed_set& seeds, outputer output) {
     static ppr_vec rsv(_g->num_nodes() + 1);
     static ppr_vec rsd(_g->num_nodes() + 1);
     std::fill(rsv.begin(), rsv.end(), 0);
     std::fill(rsd.begin(), rsd.end(), 0);
 
-    _evaluate(_g, _h, s, rsv, rsd);
+    _evaluate(_g, _h, seeds, rsv, rsd);
     _output(output, rsv);
   }
+
+  template <typename H>
+  void evaluate(graph* _g, H* _h, node_id s, outputer output) {
+    evaluate(_g, _h, seed_set{{s, 1.}}, output);
+  }
 };
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <assert.h>
+#include "log/log.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "time/counter.hpp"
+#include "time/timer.hpp"
+#include "graph.hpp"
+#include "simple_walk.hpp"
+#include "sparse_vector.hpp"
+#include "uniqueue.hpp"
+
+// single-target ppr, the ppr of a target t from every source s: backward
+// push over in-edges leaves reserves p and residues r such that
+//   ppr(s, t) = p[s] + sum_v ppr(s, v) * r[v],
+// and walks of the index from every source estimate the sum; a single pair
+// is the same bidirectional estimate for one source
+class fora_impl_target : public simple_walk {
+private:
+  using ppr_vec = std::vector<double>;
+
+  // pushes residues of at least rmax, noting the nodes they reach in
+  // touched; returns the largest residue left
+  template <typename H>
+  double _backward_push(graph* _g, H* _h, ppr_vec& rsv, ppr_vec& rsd,
+    node_id t, double rmax, std::vector<node_id>& touched)
+  {
+    static uniqueue queue(_g->num_nodes() + 1);
+    Timer tmr(TIMER::PUSH);
+
+    rsd[t] = 1.0;
+    touched.push_back(t);
+    if (rsd[t] >= rmax) queue.push(t);
+    while (!queue.empty()) {
+      node_id v = queue.pop();
+      // a walk reaching a dangling node stops there, not only with alpha
+      bool dangling = _g->is_dangling_node(v);
+      double r = rsd[v];
+      rsv[v] += dangling ? r : _h->alpha * r;
+      double detr = (1 - _h->alpha) * r / (dangling ? _h->alpha : 1.);
+      log_trace("on node %zu, rsd = %e", (size_t)v, r);
+      count_work(PUSH, 1);
+      count_work(EDGE_SCAN, _g->get_in_degree(v));
+      rsd[v] = 0;
+
+      for (node_id u : _g->get_in_neighbourhood(v)) {
+        if (rsd[u] == 0) touched.push_back(u);
+        rsd[u] += detr / _g->get_degree(u);
+        if (rsd[u] >= rmax) queue.push(u);
+      }
+    }
+
+    double rbar = 0;
+    for (node_id v : touched) rbar = std::max(rbar, rsd[v]);
+    return rbar;
+  }
+
+  // the walks of each source feed its own estimate, so the index is adapted
+  // for every source alone
+  template <typename H>
+  void _adapt(graph* _g, H* _h, node_id s, double rbar, double det) {
+    static sparse_vector rsd(_g->num_nodes() + 1);
+    rsd.clear();
+    rsd.update(s, rbar);
+    rsd.iterize();
+    _h->adapt(rsd, det);
+  }
+
+  // the mean residue where the walks of s stop; walks of the index start
+  // with a step, as the residue of s is already taken, and fresh walks
+  // make up for those beyond the index
+  template <typename H>
+  double _sample(graph* _g, H* _h, const ppr_vec& rsd, node_id s,
+    double rbar, double det)
+  {
+    record_sno c = _h->num_samples(s, rbar, det);
+    record_sno kept = std::min(c, _h->index_size(s));
+    double sum = 0;
+    count_work(SAMPLE, c);
+    for (record_sno i = 0; i < kept; ++i) sum += rsd[_h->get(s, i)];
+    for (record_sno i = kept; i < c; ++i)
+      sum += rsd[random_walk(_g, s, _h->alpha)];
+    return sum / c;
+  }
+
+  template <typename H>
+  void _combine(graph* _g, H* _h, ppr_vec& ppr, const ppr_vec& rsv,
+    const ppr_vec& rsd, double rbar, double det)
+  {
+    Timer tmr(TIMER::REFINE);
+    for (node_id s = 1, n = _g->num_nodes(); s <= n; ++s) {
+      ppr[s] = rsv[s];
+      count_work(RESIDUE, rsd[s]);
+      if (_g->is_dangling_node(s)) {
+        ppr[s] += rsd[s];
+        continue;
+      }
+      ppr[s] += _h->alpha * rsd[s];
+      if (rbar > 0)
+        ppr[s] += (1 - _h->alpha) * _sample(_g, _h, rsd, s, rbar, det);
+    }
+  }
+
+  template <typename H>
+  void _evaluate(graph* _g, H* _h, node_id t,
+    ppr_vec& ppr, ppr_vec& rsv, ppr_vec& rsd)
+  {
+    static std::vector<node_id> touched;
+    Timer tmr(TIMER::EVALUATE);
+    log_debug("backward pushing");
+    // the residue bound makes the walks of the sparsest source suffice
+    double rbar = _backward_push(_g, _h, rsv, rsd, t, _h->rmax(_h->det),
+      touched);
+    touched.clear();
+    log_debug("adjusting indecies, rbar = %e", rbar);
+    if (rbar > 0) {
+      Timer tmr2(TIMER::ADAPT);
+      for (node_id s = 1, n = _g->num_nodes(); s <= n; ++s)
+        if (!_g->is_dangling_node(s)) _adapt(_g, _h, s, rbar, _h->det);
+    }
+    log_debug("refining estimation");
+    _combine(_g, _h, ppr, rsv, rsd, rbar, _h->det);
+  }
+
+public:
+  // ppr of the target from every source
+  using outputer = std::function<void(const std::vector<double>&)>;
+
+private:
+  void _output(outputer output, const ppr_vec& ppr) {
+    Timer tmr(TIMER::OUTPUT);
+    output(ppr);
+  }
+
+protected:
+  template <typename H>
+  void evaluate(graph* _g, H* _h, node_id t, outputer output) {
+    static ppr_vec ppr(_g->num_nodes() + 1);
+    static ppr_vec rsv(_g->num_nodes() + 1);
+    static ppr_vec rsd(_g->num_nodes() + 1);
+    std::fill(rsv.begin(), rsv.end(), 0);
+    std::fill(rsd.begin(), rsd.end(), 0);
+
+    // in-edges are only kept once targets are asked for
+    _g->track_in_edges();
+    _evaluate(_g, _h, t, ppr, rsv, rsd);
+    _output(output, ppr);
+  }
+
+  // ppr(s, t) alone: pushes cost about d / (alpha * rmax) for the average
+  // in-degree d and walks (1 - alpha) * rmax * omega / alpha, so rmax
+  // balances them, unless the walks s keeps in the index suffice already
+  template <typename H>
+  double evaluate_pair(graph* _g, H* _h, node_id s, node_id t) {
+    static ppr_vec rsv(_g->num_nodes() + 1);
+    static ppr_vec rsd(_g->num_nodes() + 1);
+    static std::vector<node_id> touched;
+    Timer tmr(TIMER::EVALUATE);
+
+    if (_g->is_dangling_node(s)) return s == t ? 1. : 0.;
+    _g->track_in_edges();
+    log_debug("backward pushing");
+    double d = (double)_g->num_edges() / _g->num_nodes();
+    double rmax = std::min(1., std::max(_h->rmax(_h->det) * _g->get_degree(s),
+      sqrt(d / ((1 - _h->alpha) * _h->omega(_h->det)))));
+    double rbar = _backward_push(_g, _h, rsv, rsd, t, rmax, touched);
+    double ppr = rsv[s] + _h->alpha * rsd[s];
+    if (rbar > 0) {
+      {
+        Timer tmr2(TIMER::ADAPT);
+        _adapt(_g, _h, s, rbar, _h->det);
+      }
+      Timer tmr2(TIMER::REFINE);
+      count_work(RESIDUE, rbar);
+      ppr += (1 - _h->alpha) * _sample(_g, _h, rsd, s, rbar, _h->det);
+    }
+
+    // only what the push reached is reset, keeping pairs local
+    for (node_id v : touched) rsv[v] = rsd[v] = 0;
+    touched.clear();
+    return ppr;
+  }
+};
@@ -3,8 +3,11 @@
 #include <assert.h>
 #include "log/log.h"
 #include <algorithm>
+#include <cmath>
+#include "time/counter.hpp"
 #include "time/timer.hpp"
 #include "graph.hpp"
+#include "hub_ppr.hpp"
 #include "sparse_vector.hpp"
 #include "uniqueue.hpp"
 
@@ -30,26 +33,43 @@ private:
         tfrontier.push(u);
     }
 
+    auto spread = [&](node_id v, double r) {
+      // push method will not be invoked at dangling node
+      if (_g->is_dangling_node(v)) rsv.accumulate(v, r);
+      else {
+        rsd.accumulate(v, r);
+        if (rsd[v] >= rmax * _g->get_degree(v))
+          queue.push(v);
+        else if (rsd[v] >= rmax0 * _g->get_degree(v))
+          frontier.push(v);
+      }
+    };
     while (!queue.empty()) {
       node_id u = queue.pop();
+      if constexpr (hub_indexed<H>) {
+        const hub_ppr* hub = _h->hub(u);
+        // absorb the precomputed push from the hub when it is cheaper than
+        // the pushes the residue could trigger, at most rsd / (alpha * rmax)
+        if (hub && hub->size() * _h->alpha * rmax < rsd[u]) {
+          double r = rsd[u];
+          log_trace("on hub %zu, residue = %e", (size_t)u, r);
+          count_work(HUB_ABSORB, 1);
+          rsd.update(u, 0);
+          for (auto [v, x] : hub->rsv) rsv.accumulate(v, r * x);
+          for (auto [v, x] : hub->rsd) spread(v, r * x);
+          continue;
+        }
+      }
       rsv.accumulate(u, _h->alpha * rsd[u]);
       // dangling node cannot be in queue
       double detr = (1 - _h->alpha) * rsd[u] / _g->get_degree(u);
       log_trace("on node %zu, residue = %e, increment = %e",
         (size_t)u, rsd[u], detr);
+      count_work(PUSH, 1);
+      count_work(EDGE_SCAN, _g->get_degree(u));
       rsd.update(u, 0);
 
-      for (node_id v : _g->get_neighbourhood(u)) {
-        // push method will not be invoked at dangling node
-        if (_g->is_dangling_node(v)) rsv.accumulate(v, detr);
-        else {
-          rsd.accumulate(v, detr);
-          if (rsd[v] >= rmax * _g->get_degree(v))
-            queue.push(v);
-          else if (rsd[v] >= rmax0 * _g->get_degree(v))
-            frontier.push(v);
-        }
-      }
+      for (node_id v : _g->get_neighbourhood(u)) spread(v, detr);
     }
     while (!tfrontier.empty()) frontier.push(tfrontier.pop());
 
@@ -71,11 +91,14 @@ private:
     log_debug("evaluating...");
     ppr = rsv;
     for (node_id v : rsd) {
+      count_work(RESIDUE, fabs(rsd[v]));
       if (_g->is_dangling_node(v)) ppr.accumulate(v, rsd[v]);
       else {
         ppr.accumulate(v, _h->alpha * rsd[v]);
-        record_sno c = _h->num_samples(v, rsd[v], det);
+        // residues absorbed from hubs may be negative
+        record_sno c = _h->num_samples(v, fabs(rsd[v]), det);
         double wgh = (1 - _h->alpha) * rsd[v] / c;
+        count_work(SAMPLE, c);
         for (record_sno i = 0; i < c; ++i)
           ppr.accumulate(_h->get(v, i), wgh);
       }
@@ -96,20 +119,28 @@ private:
 
   template <typename H>
   void _evaluate(graph* _g, H* _h,
-    node_id s, node_id k, ppr_vec& ppr, ppr_vec& rsv, ppr_vec& rsd)
+    const seed_set& seeds, node_id k, ppr_vec& ppr, ppr_vec& rsv,
+    ppr_vec& rsd)
   {
     static uniqueue frontier(_g->num_nodes() + 1);
     Timer tmr(TIMER::EVALUATE);
 
     size_t num_iter = 0;
     log_debug("push round %zu, det = %e", num_iter++, 1.);
-    if (_g->is_dangling_node(s)) {
-      ppr.clear();
-      ppr.update(s, 1.0);
+    // the residue starts as the preference vector, dangling seeds keeping
+    // their weight
+    for (auto [s, x] : seeds) {
+      if (_g->is_dangling_node(s)) rsv.accumulate(s, x);
+      else {
+        rsd.accumulate(s, x);
+        frontier.push(s);
+      }
+    }
+    if (frontier.empty()) {
+      rsv.iterize();
+      ppr = rsv;
       return;
     }
-    rsd.update(s, 1.0);
-    frontier.push(s);
 
     double dfac = 1. / (log1p(_g->num_nodes()) + log1p(_g->num_edges()) + 1);
     double det = std::max(_h->det, dfac / k);
@@ -154,14 +185,21 @@ private:
 
 protected:
   template <typename H>
-  void evaluate(graph* _g, H* _h, node_id s, node_id k, outputer output) {
+  void evaluate(graph* _g, H* _h, const seed_set& seeds, node_id k,
+    outputer output)
+  {
     static ppr_vec rsv(_g->num_nodes() + 1);
     static ppr_vec rsd(_g->num_nodes() + 1);
     static ppr_vec ppr(_g->num_nodes() + 1);
     rsv.clear();
     rsd.clear();
 
-    _evaluate(_g, _h, s, k, ppr, rsv, rsd);
+    _evaluate(_g, _h, seeds, k, ppr, rsv, rsd);
     _output(output, k, ppr);
   }
+
+  template <typename H>
+  void evaluate(graph* _g, H* _h, node_id s, node_id k, outputer output) {
+    evaluate(_g, _h, seed_set{{s, 1.}}, k, output);
+  }
 };
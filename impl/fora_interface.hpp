@@ -1,9 +1,12 @@
 #pragma once
 
 #include <functional>
+#include <span>
 #include <string>
 #include <vector>
+#include "fora_impl_batch.hpp"
 #include "fora_impl_full.hpp"
+#include "fora_impl_target.hpp"
 #include "fora_impl_topk.hpp"
 #include "graph_types.hpp"
 
@@ -11,9 +14,24 @@ class fora_interface {
 public:
   struct econfigs { double alpha, epsilon, delta, pf; };
 public:
+  virtual ~fora_interface() = default;
   virtual void evaluate_full(node_id, fora_impl_full::outputer) = 0;
   virtual void evaluate_topk(node_id, node_id, fora_impl_topk::outputer) = 0;
+  // ppr of a preference vector, as one query
+  virtual void evaluate_full(const seed_set&, fora_impl_full::outputer) = 0;
+  virtual void evaluate_topk(const seed_set&, node_id,
+    fora_impl_topk::outputer) = 0;
+  virtual void evaluate_target(node_id, fora_impl_target::outputer) = 0;
+  virtual double evaluate_pair(node_id s, node_id t) = 0;
+  virtual void evaluate_batch(std::span<const node_id>,
+    fora_impl_batch::outputer) = 0;
+  // a job of many sources within max_bytes of scratch, outputs may come
+  // from several threads at once; returns the number of threads
+  virtual size_t evaluate_all(std::span<const node_id>, size_t max_bytes,
+    fora_impl_batch::outputer) = 0;
   virtual void insert_edge(node_id u, node_id v) = 0;
   virtual void delete_edge(node_id u, node_id v) = 0;
   virtual econfigs experiment_configs() = 0;
+  // the current graph, in the format of the base graph
+  virtual edge_list snapshot() = 0;
 };
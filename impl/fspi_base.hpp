@@ -12,12 +12,12 @@ protected:
 public:
   const double alpha, beta, eps, det, pf;
 
-protected:
+public:
+  // walks the index keeps at v
   record_sno index_size(node_id v) const {
     return ceil(beta * (1 - alpha) * _g->get_degree(v));
   }
 
-public:
   template <typename C>
   fspi_base(graph* g, bool is_dird, C config) :
     _g(g), _is_dird(is_dird),
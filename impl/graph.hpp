@@ -5,21 +5,82 @@
 #include <optional>
 #include <unordered_map>
 #include <vector>
+#include "lib/parallel.hpp"
 #include "lib/scarray.hpp"
 #include "graph_types.hpp"
 
-// evolvable 'directed' graph
+// evolvable 'directed' graph; an undirected graph holds both directions of
+// every edge in the same adjacency, which thus serves in-neighbours too,
+// while a directed one keeps in-neighbours on demand, in the same layout
 class graph {
 private:
+  const bool _is_dird;
+  bool _has_in;
   node_id _n_nodes;
   edge_id _n_edges;
 
   std::vector<scarray<node_id>> _edge_list;
   std::vector<std::unordered_map<node_id, edge_sno>> _edge_table;
+  std::vector<scarray<node_id>> _in_list;
+  std::vector<std::unordered_map<node_id, edge_sno>> _in_table;
+
+  void _insert_in_edge(node_id u, node_id v) {
+    if (!_has_in) return;
+    _in_table[v][u] = _in_list[v].size();
+    _in_list[v].emplace(u);
+  }
+
+  void _delete_in_edge(node_id u, node_id v) {
+    if (!_has_in) return;
+    auto it = _in_table[v].find(u);
+    assert(it != _in_table[v].end());
+    edge_sno isno = it->second;
+    _in_table[v].erase(it);
+    _in_list[v].remove(isno,
+      [this, isno, v](node_id uu) { _in_table[v][uu] = isno; });
+  }
 
 public:
-  graph(node_id n) :
-    _n_nodes(n), _n_edges(0), _edge_list(n + 1), _edge_table(n + 1) { }
+  graph(node_id n, bool is_dird = true) :
+    _is_dird(is_dird), _has_in(!is_dird), _n_nodes(n), _n_edges(0),
+    _edge_list(n + 1), _edge_table(n + 1) { }
+
+  // bulk construction: edges are bucketed by source, keeping their order,
+  // so that every adjacency is allocated once and filled in parallel; an
+  // undirected graph gets the mirror <v, u> of every edge <u, v>, u != v
+  graph(node_id n, const edge_list& edges, bool is_dird) :
+    graph(n, is_dird)
+  {
+    std::vector<size_t> offset(n + 2, 0);
+    for (auto [u, v] : edges) {
+      ++offset[u + 1];
+      if (!is_dird && u != v) ++offset[v + 1];
+    }
+    for (node_id v = 1; v <= n + 1; ++v) offset[v] += offset[v - 1];
+    std::vector<node_id> nbrs(offset[n + 1]);
+    std::vector<size_t> pos(offset.begin(), offset.end() - 1);
+    for (auto [u, v] : edges) {
+      nbrs[pos[u]++] = v;
+      if (!is_dird && u != v) nbrs[pos[v]++] = u;
+    }
+
+    parallel_for(n, [this, &offset, &nbrs](size_t i) {
+      node_id u = i + 1;
+      scarray<node_id>& list = _edge_list[u];
+      std::unordered_map<node_id, edge_sno>& table = _edge_table[u];
+      list = scarray<node_id>(offset[u + 1] - offset[u]);
+      table.reserve(offset[u + 1] - offset[u]);
+      for (size_t e = offset[u]; e < offset[u + 1]; ++e) {
+        if (!table.emplace(nbrs[e], list.size()).second) {
+          log_warn("edge <%zu, %zu> already exists", (size_t)u,
+            (size_t)nbrs[e]);
+          continue;
+        }
+        list.emplace(nbrs[e]);
+      }
+    }, 1024);
+    for (node_id u = 1; u <= n; ++u) _n_edges += _edge_list[u].size();
+  }
 
   node_id num_nodes() const noexcept {
     return _n_nodes;
@@ -44,11 +105,63 @@ public:
     return _edge_list[v];
   }
 
+  bool is_directed() const noexcept {
+    return _is_dird;
+  }
+
+  // keep in-neighbours from now on, built at once from the out-edges
+  void track_in_edges() {
+    if (_has_in) return;
+    std::vector<edge_sno> indeg(_n_nodes + 1, 0);
+    for (node_id u = 1; u <= _n_nodes; ++u)
+      for (node_id v : _edge_list[u]) ++indeg[v];
+    _in_list.resize(_n_nodes + 1);
+    _in_table.resize(_n_nodes + 1);
+    for (node_id v = 1; v <= _n_nodes; ++v)
+      _in_list[v] = scarray<node_id>(indeg[v]);
+    for (node_id u = 1; u <= _n_nodes; ++u)
+      for (node_id v : _edge_list[u]) _in_list[v].emplace(u);
+    parallel_for(_n_nodes, [this](size_t i) {
+      node_id v = i + 1;
+      _in_table[v].reserve(_in_list[v].size());
+      for (edge_sno e = 0; e < _in_list[v].size(); ++e)
+        _in_table[v][_in_list[v][e]] = e;
+    }, 1024);
+    _has_in = true;
+  }
+
+  bool has_in_edges() const noexcept {
+    return _has_in;
+  }
+
+  edge_sno get_in_degree(node_id v) const {
+    assert(_has_in && v <= _n_nodes);
+    return _is_dird ? _in_list[v].size() : _edge_list[v].size();
+  }
+
+  const scarray<node_id>& get_in_neighbourhood(node_id v) const {
+    assert(_has_in && v <= _n_nodes);
+    return _is_dird ? _in_list[v] : _edge_list[v];
+  }
+
   node_id get_neighbour(node_id v, edge_sno e) const {
     assert(v <= _n_nodes && e < _edge_list[v].size());
     return _edge_list[v][e];
   }
 
+  // every edge, those of an undirected graph once as <u, v> with u <= v
+  edge_list edges(bool is_dird) const {
+    edge_list ret;
+    ret.reserve(is_dird ? _n_edges : _n_edges / 2 + 1);
+    for (node_id u = 1; u <= _n_nodes; ++u) {
+      for (edge_sno e = 0; e < _edge_list[u].size(); ++e) {
+        node_id v = _edge_list[u][e];
+        if (is_dird || u <= v) ret.emplace_back(u, v);
+      }
+    }
+    return ret;
+  }
+
   std::optional<edge_sno> get_edge_sno(node_id u, node_id v) const {
     auto it = _edge_table[u].find(v);
     if (it == _edge_table[u].end()) return std::nullopt;
@@ -65,6 +178,7 @@ public:
     ++_n_edges;
     _edge_list[u].emplace(v);
     _edge_table[u][v] = _edge_list[u].size() - 1;
+    if (_is_dird) _insert_in_edge(u, v);
     return std::make_optional(_edge_table[u][v]);
   }
 
@@ -81,6 +195,7 @@ public:
     _edge_table[u].erase(it);
     _edge_list[u].remove(esno,
       [this, esno, u](node_id vv) { _edge_table[u][vv] = esno; });
+    if (_is_dird) _delete_in_edge(u, v);
     return std::make_optional(esno);
   }
 
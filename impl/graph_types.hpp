@@ -15,6 +15,9 @@ using edge = std::pair<node_id, node_id>;
 
 using edge_list = std::vector<edge>;
 
+// weighted sources of a query, the weights summing to 1
+using seed_set = std::vector<std::pair<node_id, double>>;
+
 #ifndef DENSE_GRAPH
   using edge_id = node_id;
 #else
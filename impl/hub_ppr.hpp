@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <unordered_map>
+#include <vector>
+#include "graph.hpp"
+
+// forward push result from a hub h, so that
+//   ppr(h, .) = rsv + sum_w rsd[w] * ppr(w, .)
+// residues may turn negative after updates, and for non-dangling u,
+// rsv[u] / alpha is the mass ever pushed out of u
+class hub_ppr {
+public:
+  std::unordered_map<node_id, double> rsv, rsd;
+
+private:
+  // push residues of magnitude at least rmax * dout, dangling nodes keep
+  // their residue as reserve
+  void _push(const graph* g, double alpha, double rmax,
+    std::vector<node_id>& stack)
+  {
+    while (!stack.empty()) {
+      node_id u = stack.back();
+      stack.pop_back();
+      auto it = rsd.find(u);
+      if (it == rsd.end()) continue;
+      double r = it->second;
+      if (g->is_dangling_node(u)) {
+        rsv[u] += r;
+        rsd.erase(it);
+        continue;
+      }
+      if (fabs(r) < rmax * g->get_degree(u)) continue;
+      rsd.erase(it);
+      rsv[u] += alpha * r;
+      double detr = (1 - alpha) * r / g->get_degree(u);
+      for (node_id v : g->get_neighbourhood(u)) {
+        if (g->is_dangling_node(v)) rsv[v] += detr;
+        else {
+          double& rv = rsd[v];
+          rv += detr;
+          if (fabs(rv) >= rmax * g->get_degree(v)) stack.push_back(v);
+        }
+      }
+    }
+  }
+
+public:
+  size_t size() const noexcept {
+    return rsv.size() + rsd.size();
+  }
+
+  void build(const graph* g, double alpha, double rmax, node_id h) {
+    std::vector<node_id> stack = {h};
+    rsv.clear();
+    rsd.clear();
+    rsd[h] = 1.;
+    _push(g, alpha, rmax, stack);
+  }
+
+  // edge <u, v> has been inserted into g
+  void update_insert(const graph* g, double alpha, double rmax,
+    node_id u, node_id v)
+  {
+    auto it = rsv.find(u);
+    if (it == rsv.end()) return;
+    edge_sno d = g->get_degree(u);
+    double x = it->second;
+    if (d == 1) {
+      // u was dangling, the mass kept on it becomes residue
+      rsv.erase(it);
+      rsd[u] += x;
+    } else {
+      // scale the pushed mass so the old neighbours keep their share
+      double pu = x / alpha;
+      it->second = x * d / (d - 1);
+      rsd[u] -= pu / (d - 1);
+      rsd[v] += (1 - alpha) * pu / (d - 1);
+    }
+    std::vector<node_id> stack = {u, v};
+    _push(g, alpha, rmax, stack);
+  }
+
+  // edge <u, v> has been deleted from g
+  void update_delete(const graph* g, double alpha, double rmax,
+    node_id u, node_id v)
+  {
+    auto it = rsv.find(u);
+    if (it == rsv.end()) return;
+    edge_sno d = g->get_degree(u);
+    double pu = it->second / alpha;
+    if (d == 0) rsv.erase(it);
+    else it->second *= (double)d / (d + 1);
+    rsd[u] += pu / (d + 1);
+    rsd[v] -= (1 - alpha) * pu / (d + 1);
+    std::vector<node_id> stack = {u, v};
+    _push(g, alpha, rmax, stack);
+  }
+};
+
+// indexing schemes that store hub push results
+template <typename H>
+concept hub_indexed = requires(const H& h, node_id u) {
+  { h.hub(u) } -> std::convertible_to<const hub_ppr*>;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// number of threads used by parallel loops, 0 means hardware concurrency
+size_t parallel_threads = 0;
+
+size_t num_workers() {
+  if (parallel_threads) return parallel_threads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// run f(0), ..., f(n - 1) across the workers, or at most max_workers of them,
+// handing out chunks of `grain` indices on demand so that skewed iterations
+// are balanced
+template <typename F>
+void parallel_for(size_t n, F f, size_t grain = 1, size_t max_workers = 0) {
+  size_t nthr = std::min(max_workers ? std::min(max_workers, num_workers()) :
+    num_workers(), (n + grain - 1) / grain);
+  if (nthr <= 1) {
+    for (size_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+
+  std::atomic<size_t> next = 0;
+  auto work = [&next, &f, n, grain]() {
+    for (size_t i; (i = next.fetch_add(grain)) < n; )
+      for (size_t j = i, e = std::min(n, i + grain); j < e; ++j) f(j);
+  };
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < nthr; ++t) workers.emplace_back(work);
+  work();
+  for (auto& w : workers) w.join();
+}
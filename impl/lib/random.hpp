@@ -4,7 +4,8 @@
 #include <cstdint>
 #include <random>
 
-std::mt19937 rand_uint{(std::random_device())()};
+// each thread draws from its own generator
+thread_local std::mt19937 rand_uint{(std::random_device())()};
 
 double rand_uniformf() {
   return 0x1.0p-32 * rand_uint();
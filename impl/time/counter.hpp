@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// algorithmic work done by evaluations and index maintenance
+enum struct COUNTER : size_t {
+  PUSH,         // push operations
+  EDGE_SCAN,    // edges scanned by pushes
+  HUB_ABSORB,   // precomputed hub pushes absorbed
+  RESIDUE,      // residue mass left for refinement
+  SAMPLE,       // random-walk samples drawn for refinement
+  WALK_REGEN,   // random walks resampled by index adaption or rebuilding
+  WALK_REPAIR,  // random walks (or segments) repaired by updates
+  _
+};
+
+constexpr std::array<const char*, (size_t)COUNTER::_> counter_names {
+  "push", "edge_scan", "hub_absorb", "residue",
+  "sample", "walk_regen", "walk_repair"
+};
+
+// counters of the calling thread
+class Counter {
+public:
+  using values = std::array<double, (size_t)COUNTER::_>;
+
+private:
+  static thread_local values counters;
+
+public:
+  static void add(COUNTER c, double x) noexcept {
+    counters[(size_t)c] += x;
+  }
+
+  static double get(COUNTER c) noexcept {
+    return counters[(size_t)c];
+  }
+
+  static const values& snapshot() noexcept {
+    return counters;
+  }
+
+  static void reset_all() noexcept {
+    counters.fill(0);
+  }
+};
+
+thread_local Counter::values Counter::counters { };
+
+#ifdef WORK_COUNTERS
+  #define count_work(c, x) (Counter::add(COUNTER::c, (x)))
+#else
+  #define count_work(c, x) ((void)0)
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// log-linear latency histogram in the style of HDR histograms, values below
+// 2^precision are exact, larger values keep `precision` significant bits;
+// recording is lock-free and safe from multiple threads
+template <unsigned precision = 7>
+class histogram {
+private:
+  static constexpr size_t _sub = size_t(1) << precision;
+  static constexpr size_t _n_buckets = (64 - precision + 1) * _sub;
+
+  std::array<std::atomic<uint64_t>, _n_buckets> _buckets;
+  std::atomic<uint64_t> _count, _sum, _max;
+
+  static size_t _index(uint64_t v) noexcept {
+    if (v < _sub) return v;
+    unsigned e = std::bit_width(v) - 1;
+    return ((e - precision + 1) << precision) +
+      ((v >> (e - precision)) & (_sub - 1));
+  }
+
+  // the largest value falling in the given bucket
+  static uint64_t _value(size_t idx) noexcept {
+    if (idx < _sub) return idx;
+    unsigned g = idx >> precision;
+    return ((_sub + (idx & (_sub - 1)) + 1) << (g - 1)) - 1;
+  }
+
+public:
+  histogram() { reset(); }
+
+  void reset() noexcept {
+    for (auto& b : _buckets) b.store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+  void record(uint64_t v) noexcept {
+    _buckets[_index(v)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(v, std::memory_order_relaxed);
+    uint64_t m = _max.load(std::memory_order_relaxed);
+    while (m < v && !_max.compare_exchange_weak(m, v,
+      std::memory_order_relaxed));
+  }
+
+  uint64_t count() const noexcept {
+    return _count.load(std::memory_order_relaxed);
+  }
+
+  uint64_t sum() const noexcept {
+    return _sum.load(std::memory_order_relaxed);
+  }
+
+  uint64_t max() const noexcept {
+    return _max.load(std::memory_order_relaxed);
+  }
+
+  // smallest recorded value v such that a fraction q of values are <= v,
+  // up to the bucket resolution
+  uint64_t quantile(double q) const noexcept {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)(q * n + 0.5));
+    uint64_t acc = 0;
+    for (size_t idx = 0; idx < _n_buckets; ++idx) {
+      acc += _buckets[idx].load(std::memory_order_relaxed);
+      if (acc >= target) return std::min(_value(idx), max());
+    }
+    return max();
+  }
+};
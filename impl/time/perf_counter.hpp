@@ -0,0 +1,134 @@
+#pragma once
+
+#include "log/log.h"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// hardware events sampled around each timer scope
+enum struct PERF_EVENT : size_t {
+  CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, _
+};
+
+constexpr std::array<const char*, (size_t)PERF_EVENT::_> perf_event_names {
+  "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+// a group of hardware counters of the calling thread and of the threads it
+// starts afterwards, counting user space only; the work of such a thread is
+// added once it exits, which parallel loops wait for; reads fail when the
+// kernel refuses to open the counters
+class perf_counter {
+public:
+  using values = std::array<uint64_t, (size_t)PERF_EVENT::_>;
+
+private:
+  int _leader;
+  std::array<int, (size_t)PERF_EVENT::_> _fds;
+
+  static int _open(uint32_t type, uint64_t config, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // inherited counters cannot be read as a group, each is read alone
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+  }
+
+public:
+  perf_counter() : _leader(-1) {
+    constexpr std::array<std::pair<uint32_t, uint64_t>, (size_t)PERF_EVENT::_>
+    events {{
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+    for (size_t e = 0; e < events.size(); ++e) {
+      _fds[e] = _open(events[e].first, events[e].second, _leader);
+      if (_fds[e] < 0) {
+        log_warn("cannot open hardware counter %s: %s",
+          perf_event_names[e], strerror(errno));
+        for (size_t i = 0; i < e; ++i) close(_fds[i]);
+        _leader = -1;
+        return;
+      }
+      if (e == 0) _leader = _fds[0];
+    }
+    ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  ~perf_counter() {
+    if (_leader < 0) return;
+    for (int fd : _fds) close(fd);
+  }
+
+  perf_counter(const perf_counter&) = delete;
+  perf_counter& operator =(const perf_counter&) = delete;
+
+  bool enabled() const noexcept {
+    return _leader >= 0;
+  }
+
+  // counts scaled up by the time the kernel multiplexed the group out;
+  // false if they cannot be read, or have never been scheduled
+  bool read(values& v) const {
+    if (_leader < 0) return false;
+    for (size_t e = 0; e < _fds.size(); ++e) {
+      struct { uint64_t value, enabled, running; } buf;
+      if (::read(_fds[e], &buf, sizeof(buf)) != sizeof(buf) ||
+        buf.running == 0) return false;
+      v[e] = buf.running == buf.enabled ? buf.value :
+        (uint64_t)((double)buf.value * buf.enabled / buf.running);
+    }
+    return true;
+  }
+
+  // counters of the calling thread, opened on first use, which should come
+  // before it starts the threads to count
+  static const perf_counter& local() {
+    static thread_local perf_counter pc;
+    return pc;
+  }
+};
+
+// thread-safe totals of sampled events
+class perf_totals {
+private:
+  std::array<std::atomic<uint64_t>, (size_t)PERF_EVENT::_> _totals;
+
+public:
+  perf_totals() { reset(); }
+
+  void reset() noexcept {
+    for (auto& t : _totals) t.store(0, std::memory_order_relaxed);
+  }
+
+  void add(const perf_counter::values& from,
+    const perf_counter::values& to) noexcept
+  {
+    // scaled counts are estimates, which may go back slightly
+    for (size_t e = 0; e < _totals.size(); ++e)
+      if (to[e] > from[e])
+        _totals[e].fetch_add(to[e] - from[e], std::memory_order_relaxed);
+  }
+
+  uint64_t get(PERF_EVENT e) const noexcept {
+    return _totals[(size_t)e].load(std::memory_order_relaxed);
+  }
+};
@@ -2,44 +2,129 @@
 
 #include <array>
 #include <chrono>
+#include <cstdio>
+#include <string>
+#include "time/histogram.hpp"
+#ifdef PERF_COUNTERS
+  #include "time/perf_counter.hpp"
+#endif
 
+// phases of evaluation, followed by whole operations of a workload
 enum struct TIMER : size_t {
-  UPDATE, EVALUATE, PUSH, ADAPT, REFINE, CHECK_K, OUTPUT, _
+  UPDATE, EVALUATE, PUSH, ADAPT, REFINE, CHECK_K, OUTPUT, SYNC,
+  INSERT, DELETE, QUERY_FULL, QUERY_TOPK, QUERY_TARGET, QUERY_PAIR,
+  QUERY_BATCH, _
+};
+
+constexpr std::array<const char*, (size_t)TIMER::_> timer_names {
+  "update", "evaluate", "push", "adapt", "refine", "check_k", "output",
+  "sync", "insert", "delete", "query_full", "query_topk", "query_target",
+  "query_pair", "query_batch"
 };
 
 class Timer {
 private:
-  static std::array<double, (size_t)TIMER::_> timers;
+  static std::array<histogram<>, (size_t)TIMER::_> timers;
+#ifdef PERF_COUNTERS
+  static std::array<perf_totals, (size_t)TIMER::_> perfs;
+#endif
 
 public:
+  // total seconds spent
   static double used(TIMER timer) {
+    return 1e-9 * timers[(size_t)timer].sum();
+  }
+
+  static const histogram<>& latency(TIMER timer) {
     return timers[(size_t)timer];
   }
 
   static void reset(TIMER timer) {
-    timers[(size_t)timer] = 0;
+    timers[(size_t)timer].reset();
   }
 
   static void reset_all() {
-    for (size_t id = 0; id < (size_t)TIMER::_; ++id) timers[id] = 0;
+    for (size_t id = 0; id < (size_t)TIMER::_; ++id) timers[id].reset();
+#ifdef PERF_COUNTERS
+    for (size_t id = 0; id < (size_t)TIMER::_; ++id) perfs[id].reset();
+#endif
+  }
+
+#ifdef PERF_COUNTERS
+  // hardware events counted within the scopes of a timer
+  static const perf_totals& perf(TIMER timer) {
+    return perfs[(size_t)timer];
+  }
+#endif
+
+  // latencies are exported in microseconds
+  static bool export_json(const std::string& filename) {
+    FILE* f = fopen(filename.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "{\n");
+    for (size_t id = 0; id < (size_t)TIMER::_; ++id) {
+      const histogram<>& h = timers[id];
+      fprintf(f, "  \"%s\": {\"count\": %zu, \"total_s\": %.9f, "
+        "\"p50_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, "
+        "\"max_us\": %.3f}%s\n",
+        timer_names[id], (size_t)h.count(), 1e-9 * h.sum(),
+        1e-3 * h.quantile(.50), 1e-3 * h.quantile(.95),
+        1e-3 * h.quantile(.99), 1e-3 * h.max(),
+        id + 1 < (size_t)TIMER::_ ? "," : "");
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+    return true;
+  }
+
+  static bool export_csv(const std::string& filename) {
+    FILE* f = fopen(filename.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "timer,count,total_s,p50_us,p95_us,p99_us,max_us\n");
+    for (size_t id = 0; id < (size_t)TIMER::_; ++id) {
+      const histogram<>& h = timers[id];
+      fprintf(f, "%s,%zu,%.9f,%.3f,%.3f,%.3f,%.3f\n",
+        timer_names[id], (size_t)h.count(), 1e-9 * h.sum(),
+        1e-3 * h.quantile(.50), 1e-3 * h.quantile(.95),
+        1e-3 * h.quantile(.99), 1e-3 * h.max());
+    }
+    fclose(f);
+    return true;
   }
 
 private:
   using clock = std::chrono::steady_clock;
-  using duration = std::chrono::duration<double>;
+  using duration = std::chrono::nanoseconds;
 
   const size_t _timer_id;
   const clock::time_point _setup_time;
+#ifdef PERF_COUNTERS
+  perf_counter::values _setup_perf;
+  // a scope whose counters cannot be read is not sampled
+  const bool _perf_read;
+#endif
 
 public:
   Timer(TIMER timer) :
       _timer_id((size_t)timer),
-      _setup_time(clock::steady_clock::now()) { }
+      _setup_time(clock::steady_clock::now())
+#ifdef PERF_COUNTERS
+      , _setup_perf(), _perf_read(perf_counter::local().read(_setup_perf))
+#endif
+      { }
 
   ~Timer() {
-    timers[_timer_id] +=
-      std::chrono::duration_cast<duration>(clock::now() - _setup_time).count();
+#ifdef PERF_COUNTERS
+    perf_counter::values perf;
+    if (_perf_read && perf_counter::local().read(perf))
+      perfs[_timer_id].add(_setup_perf, perf);
+#endif
+    timers[_timer_id].record(
+      std::chrono::duration_cast<duration>(clock::now() - _setup_time).count());
   }
 };
 
-std::array<double, (size_t)TIMER::_> Timer::timers { };
+std::array<histogram<>, (size_t)TIMER::_> Timer::timers { };
+#ifdef PERF_COUNTERS
+std::array<perf_totals, (size_t)TIMER::_> Timer::perfs { };
+#endif
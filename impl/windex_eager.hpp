@@ -2,53 +2,148 @@
 
 #include <assert.h>
 #include "log/log.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
 #include <vector>
-#include "lib/scarray.hpp"
+#include "lib/parallel.hpp"
+#include "lib/random.hpp"
+#include "time/counter.hpp"
 #include "fspi_base.hpp"
 #include "simple_walk.hpp"
 
+// random-walk indexing scheme for fora+, the index is rebuilt in background
+// into a shadow buffer while queries keep reading the current one
 class windex_eager : public simple_walk, public fspi_base {
 private:
-  std::vector<path_id> _woffset;
-  std::vector<node_id> _tpoints;
-
-  void _reconstruct() {
-    _tpoints.clear();
-    for (node_id v = 1; v <= _g->num_nodes(); ++v) {
-      _woffset[v] = _tpoints.size();
-      for (record_sno wnum = index_size(v); wnum; --wnum)
-        _tpoints.push_back(random_walk(_g, v, alpha));
+  using clock = std::chrono::steady_clock;
+  using duration = std::chrono::duration<double, std::milli>;
+
+  struct buffer {
+    std::vector<path_id> woffset;
+    std::vector<node_id> tpoints;
+  };
+
+  // a rebuild starts once this many updates are pending, or once the oldest
+  // pending update is older than this many milliseconds (0 to disable)
+  const size_t _stale_updates;
+  const double _stale_ms;
+
+  buffer _buf[2];
+  buffer* _cur;
+  buffer* _shadow;
+
+  // snapshot of the graph to be sampled by the background rebuild
+  std::vector<edge_id> _soffset;
+  std::vector<node_id> _sedges;
+
+  std::thread _builder;
+  std::atomic<bool> _ready;
+  size_t _n_stale;
+  clock::time_point _stale_since;
+
+  node_id _snapshot_walk(node_id v) const {
+    while (true) {
+      edge_id b = _soffset[v], d = _soffset[v + 1] - b;
+      if (d == 0) return v;
+      v = _sedges[b + rand_uniform(d)];
+      if (rand_uniformf() < alpha) return v;
     }
   }
 
+  void _snapshot() {
+    node_id n = _g->num_nodes();
+    _sedges.clear();
+    _shadow->woffset[1] = 0;
+    for (node_id v = 1; v <= n; ++v) {
+      const scarray<node_id>& nbrs = _g->get_neighbourhood(v);
+      _soffset[v] = _sedges.size();
+      _sedges.insert(_sedges.end(), nbrs.begin(), nbrs.end());
+      _shadow->woffset[v + 1] = _shadow->woffset[v] + index_size(v);
+    }
+    _soffset[n + 1] = _sedges.size();
+  }
+
+  void _resample() {
+    buffer& b = *_shadow;
+    b.tpoints.resize(b.woffset.back());
+    parallel_for(b.woffset.size() - 2, [this, &b](size_t i) {
+      node_id v = i + 1;
+      for (path_id w = b.woffset[v]; w < b.woffset[v + 1]; ++w)
+        b.tpoints[w] = _snapshot_walk(v);
+    }, 1024);
+    _ready.store(true, std::memory_order_release);
+  }
+
+  void _start_rebuild() {
+    log_debug("rebuilding random walk(s) for %zu update(s)", _n_stale);
+    _snapshot();
+    count_work(WALK_REGEN, _shadow->woffset.back());
+    _n_stale = 0;
+    _builder = std::thread(&windex_eager::_resample, this);
+  }
+
+  // adopt a finished rebuild, then start another one if it is due
+  void _sync() {
+    if (_builder.joinable() && _ready.load(std::memory_order_acquire)) {
+      _builder.join();
+      _ready.store(false, std::memory_order_relaxed);
+      std::swap(_cur, _shadow);
+      log_debug("swapped in %zu random walk(s)", _cur->tpoints.size());
+    }
+    if (_builder.joinable() || _n_stale == 0) return;
+    if (_n_stale >= _stale_updates || (_stale_ms > 0 &&
+      duration(clock::now() - _stale_since).count() >= _stale_ms))
+      _start_rebuild();
+  }
+
+  void _stale() {
+    if (_n_stale++ == 0) _stale_since = clock::now();
+    _sync();
+  }
+
 public:
   template <typename C>
   windex_eager(graph* g, bool is_dird, C config) :
     fspi_base(g, is_dird, config),
-    _woffset(g->num_nodes() + 1),
-    _tpoints()
+    _stale_updates(config.stale_updates),
+    _stale_ms(config.stale_ms),
+    _cur(&_buf[0]), _shadow(&_buf[1]),
+    _soffset(g->num_nodes() + 2),
+    _sedges(),
+    _ready(false), _n_stale(0)
   {
-    _reconstruct();
+    for (buffer& b : _buf) b.woffset.resize(g->num_nodes() + 2);
+    _snapshot();
+    _resample();
+    _ready.store(false, std::memory_order_relaxed);
+    std::swap(_cur, _shadow);
+  }
+
+  ~windex_eager() {
+    if (_builder.joinable()) _builder.join();
   }
 
   template <typename Vec>
-  void adapt(const Vec&, double) { }
+  void adapt(const Vec&, double) {
+    _sync();
+  }
 
   node_id get(node_id s, record_sno wsno) const {
-    return _tpoints[_woffset[s] + wsno];
+    path_id w = _cur->woffset[s] + wsno;
+    // s has gained out-edges since the buffer was sampled
+    if (w >= _cur->woffset[s + 1]) return random_walk(_g, s, alpha);
+    return _cur->tpoints[w];
   }
 
   void update_insert(node_id u, node_id v, edge_sno) {
     if (!_is_dird && !_g->get_edge_sno(v, u)) return;
-    log_debug("reconstructing random walk(s)");
-    _reconstruct();
-    log_debug("reconstructed %zu random walk(s)", _tpoints.size());
+    _stale();
   }
 
   void update_delete(node_id u, node_id v, edge_sno) {
     if (!_is_dird && _g->get_edge_sno(v, u)) return;
-    log_debug("reconstructing random walk(s)");
-    _reconstruct();
-    log_debug("reconstructed %zu random walk(s)", _tpoints.size());
+    _stale();
   }
 };
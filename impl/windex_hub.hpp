@@ -0,0 +1,60 @@
+#pragma once
+
+#include <assert.h>
+#include "log/log.h"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "lib/parallel.hpp"
+#include "hub_ppr.hpp"
+
+// random-walk indexing scheme W extended with precomputed forward pushes
+// from the top out-degree hubs
+template <typename W>
+class windex_hub : public W {
+private:
+  const double _hub_rmax;
+  std::vector<node_id> _hub_of;
+  std::vector<hub_ppr> _hubs;
+
+public:
+  template <typename C>
+  windex_hub(graph* g, bool is_dird, C config) :
+    W(g, is_dird, config),
+    _hub_rmax(config.hub_ratio * this->rmax(this->det)),
+    _hub_of(g->num_nodes() + 1),
+    _hubs()
+  {
+    std::vector<node_id> ids(g->num_nodes());
+    std::iota(ids.begin(), ids.end(), 1);
+    size_t h = std::min(config.hubs, ids.size());
+    std::partial_sort(ids.begin(), ids.begin() + h, ids.end(),
+      [g](node_id u, node_id v) {
+        return g->get_degree(u) > g->get_degree(v);
+      });
+    while (h && g->is_dangling_node(ids[h - 1])) --h;
+
+    _hubs.resize(h);
+    for (size_t i = 0; i < h; ++i) _hub_of[ids[i]] = i + 1;
+    parallel_for(h, [this, g, &ids](size_t i) {
+      _hubs[i].build(g, this->alpha, _hub_rmax, ids[i]);
+    });
+    log_debug("precomputed forward push from %zu hub(s)", h);
+  }
+
+  const hub_ppr* hub(node_id u) const {
+    return _hub_of[u] ? &_hubs[_hub_of[u] - 1] : nullptr;
+  }
+
+  void update_insert(node_id u, node_id v, edge_sno esno) {
+    W::update_insert(u, v, esno);
+    for (hub_ppr& hv : _hubs)
+      hv.update_insert(this->_g, this->alpha, _hub_rmax, u, v);
+  }
+
+  void update_delete(node_id u, node_id v, edge_sno esno) {
+    W::update_delete(u, v, esno);
+    for (hub_ppr& hv : _hubs)
+      hv.update_delete(this->_g, this->alpha, _hub_rmax, u, v);
+  }
+};
@@ -6,6 +6,7 @@
 #include <unordered_set>
 #include <vector>
 #include "lib/scarray.hpp"
+#include "time/counter.hpp"
 #include "fspi_base.hpp"
 #include "simple_walk.hpp"
 
@@ -315,6 +316,7 @@ public:
     }
 
     // adjust sampled random-walks
+    count_work(WALK_REPAIR, __update_list.size());
     for (auto it : __update_list) {
       _hit_edge(it.first, it.second, u, d_out - 1);
       _random_walk(it.first, it.second + 1);
@@ -348,6 +350,7 @@ public:
     }
 
     // repair traced random-walks
+    count_work(WALK_REPAIR, __update_list.size());
     for (auto it : __update_list) {
       _revert_walk(it.first, it.second);
       _random_walk(it.first, it.second);
@@ -3,10 +3,10 @@
 #include <assert.h>
 #include "log/log.h"
 #include <algorithm>
-#include <queue>
-#include <unordered_map>
+#include <cmath>
 #include <vector>
-#include "lib/scarray.hpp"
+#include "lib/parallel.hpp"
+#include "time/counter.hpp"
 #include "fspi_base.hpp"
 #include "simple_walk.hpp"
 #include "sparse_vector.hpp"
@@ -17,16 +17,25 @@ class windex_lazy : public simple_walk, public fspi_base {
 private:
   const double _theta, _epsi;
 
-  std::vector<scarray<node_id>> _redge_list;
-  std::vector<std::unordered_map<node_id, edge_sno>> _redge_table;
-
-  double _ssum;
+  // the inaccuracy of v is _sigma[v] + _soff, where _soff accumulates the
+  // uniform term shared by all nodes so that updates need not touch every node
+  double _ssum, _soff;
   std::vector<double> _sigma;
   std::vector<std::vector<node_id>> _tpoints;
 
 private:
+  double _inaccuracy(node_id v) const {
+    return _sigma[v] + _soff;
+  }
+
+  void _reset_inaccuracy(node_id v) {
+    _ssum -= _inaccuracy(v);
+    _sigma[v] = -_soff;
+  }
+
   void _update_inaccuracy(node_id t, unsigned del) {
     static std::vector<double> rbak(_g->num_nodes() + 1);
+    static std::vector<node_id> touched;
     static uniqueue queue(_g->num_nodes() + 1);
 
     log_debug("updating inaccuracy");
@@ -34,70 +43,50 @@ private:
     double rbmax = _is_dird ?
       1. / _g->num_nodes() :
       2. * doutt / (_g->num_edges() + 2 * del);
-    std::fill(rbak.begin(), rbak.end(), 0);
     rbak[t] = 1.;
+    touched.push_back(t);
     if (rbak[t] > rbmax) queue.push(t);
     while (!queue.empty()) {
       node_id u = queue.pop();
       double rbaku = rbak[u];
       rbak[u] = .0;
       _sigma[u] += rbaku / doutt;
-      for (node_id v : _redge_list[u]) {
+      _ssum += rbaku / doutt;
+      for (node_id v : _g->get_in_neighbourhood(u)) {
+        if (rbak[v] == 0) touched.push_back(v);
         rbak[v] += (1 - alpha) * rbaku / _g->get_degree(v);
         if (rbak[v] > rbmax) queue.push(v);
       }
     }
+    for (node_id v : touched) rbak[v] = .0;
+    log_debug("touched %zu node(s)", touched.size());
+    touched.clear();
 
-    _ssum = 0;
-    for (node_id v = 1; v <= _g->num_nodes(); ++v) {
-      _sigma[v] += rbmax / (alpha * doutt);
-      _ssum += _sigma[v];
-    }
+    double soff = rbmax / (alpha * doutt);
+    _soff += soff;
+    _ssum += soff * _g->num_nodes();
   }
 
-  double _eval_inaccuracy(
-    const std::vector<double>& rsd,
-    std::vector<double>& inacc,
-    std::priority_queue<std::pair<double, node_id>>& heap)
-  {
-    double esum = .0;
-    for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v) {
-      if (rsd[v] == 0 || _sigma[v] == 0 || _tpoints[v].empty()) continue;
-      inacc[v] = rsd[v] * _sigma[v];
-      esum += inacc[v];
-      heap.push(std::make_pair(inacc[v] / _tpoints[v].size(), v));
-    }
-    return esum;
+  using candidates = std::vector<std::pair<double, node_id>>;
+
+  void _add_candidate(node_id v, double r, double& esum, candidates& heap) {
+    if (r == 0 || _inaccuracy(v) == 0 || _tpoints[v].empty()) return;
+    double inacc = fabs(r) * _inaccuracy(v);
+    esum += inacc;
+    heap.push_back(std::make_pair(inacc / _tpoints[v].size(), v));
   }
 
-  double _eval_inaccuracy(
-    const sparse_vector& rsd,
-    std::vector<double>& inacc,
-    std::priority_queue<std::pair<double, node_id>>& heap)
-  {
+  double _eval_inaccuracy(const std::vector<double>& rsd, candidates& heap) {
     double esum = .0;
-    for (node_id v : rsd) {
-      if (_sigma[v] == 0 || _tpoints[v].empty()) continue;
-      inacc[v] = rsd[v] * _sigma[v];
-      esum += inacc[v];
-      heap.push(std::make_pair(inacc[v] / _tpoints[v].size(), v));
-    }
+    for (node_id v = 1, n = _g->num_nodes(); v <= n; ++v)
+      if (rsd[v] != 0) _add_candidate(v, rsd[v], esum, heap);
     return esum;
   }
 
-  void _insert_redge(node_id u, node_id v) {
-    assert(_redge_table[v].find(u) == _redge_table[v].end());
-    _redge_list[v].emplace(u);
-    _redge_table[v][u] = _redge_list[v].size() - 1;
-  }
-
-  void _delete_redge(node_id u, node_id v) {
-    assert(_redge_table[v].find(u) != _redge_table[v].end());
-    edge_sno resno = _redge_table[v][u];
-    _redge_table[v].erase(u);
-    _redge_list[v].remove(resno,
-      [this, resno, v](node_id uu) { _redge_table[v][uu] = resno; }
-    );
+  double _eval_inaccuracy(const sparse_vector& rsd, candidates& heap) {
+    double esum = .0;
+    for (node_id v : rsd) _add_candidate(v, rsd[v], esum, heap);
+    return esum;
   }
 
   template <typename C>
@@ -115,15 +104,11 @@ public:
     fspi_base(g, is_dird, _reconfig(config)),
     _theta(config.theta),
     _epsi((1 - config.theta) * config.eps),
-    _redge_list(g->num_nodes() + 1),
-    _redge_table(g->num_nodes() + 1),
-    _ssum(0), _sigma(g->num_nodes() + 1),
+    _ssum(0), _soff(0), _sigma(g->num_nodes() + 1),
     _tpoints(g->num_nodes() + 1)
   {
-    for (node_id u = 1; u <= _g->num_nodes(); ++u) {
-      for (node_id v : _g->get_neighbourhood(u))
-        _insert_redge(u, v);
-    }
+    // in-neighbours are kept up to date by the graph itself
+    _g->track_in_edges();
     for (node_id v = 1; v <= _g->num_nodes(); ++v)
       for (record_sno wnum = index_size(v); wnum; --wnum)
         _tpoints[v].push_back(random_walk(_g, v, alpha));
@@ -131,42 +116,62 @@ public:
 
   template <typename Vec>
   void adapt(const Vec& rsd, double delta) {
-    static std::vector<double> inacc(_g->num_nodes() + 1);
+    // regenerating fewer walks than this is not worth spawning threads
+    constexpr size_t min_parallel_walks = 1 << 14;
+    static candidates heap;
+    static std::vector<node_id> regen;
 
     double emax = _epsi * delta;
     log_debug("updating inaccurate random walks, emax = %e", emax);
     if (_ssum <= emax) return;
 
-    std::fill(inacc.begin(), inacc.end(), 0);
-    std::priority_queue<std::pair<double, node_id>> heap;
-    double esum = _eval_inaccuracy(rsd, inacc, heap);
+    heap.clear();
+    double esum = _eval_inaccuracy(rsd, heap);
+    if (esum <= emax) return;
+
+    // only the most inaccurate candidates are popped, so heapify lazily
+    // instead of sorting all of them
+    regen.clear();
+    size_t n_walks = 0;
+    std::make_heap(heap.begin(), heap.end());
+    while (esum > emax && !heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end());
+      node_id v = heap.back().second;
+      heap.pop_back();
+      esum -= fabs(rsd[v]) * _inaccuracy(v);
+      _reset_inaccuracy(v);
+      regen.push_back(v);
+      n_walks += _tpoints[v].size();
+    }
 
-    while (esum > emax) {
-      node_id v = heap.top().second;
-      log_trace("regenerating random-walks starting from %zu", (size_t)v);
+    log_debug("regenerating %zu random-walk(s) from %zu node(s)",
+      n_walks, regen.size());
+    count_work(WALK_REGEN, n_walks);
+    auto regenerate = [this](size_t i) {
+      node_id v = regen[i];
       for (record_sno k = 0; k < _tpoints[v].size(); ++k)
         _tpoints[v][k] = random_walk(_g, v, alpha);
-      _ssum -= _sigma[v];
-      _sigma[v] = 0;
-      esum -= inacc[v];
-    }
+    };
+    if (n_walks < min_parallel_walks)
+      for (size_t i = 0; i < regen.size(); ++i) regenerate(i);
+    else
+      parallel_for(regen.size(), regenerate);
   }
 
   node_id get(node_id s, record_sno wsno) const {
     return _tpoints[s][wsno];
   }
 
-  void update_insert(node_id u, node_id v, edge_sno) {
-    _insert_redge(u, v);
+  void update_insert(node_id u, node_id, edge_sno) {
     _update_inaccuracy(u, 0);
     while (index_size(u) > _tpoints[u].size()) {
       log_trace("add new random-walk at node %zu", (size_t)u);
+      count_work(WALK_REPAIR, 1);
       _tpoints[u].push_back(random_walk(_g, u, alpha));
     }
   }
 
-  void update_delete(node_id u, node_id v, edge_sno) {
-    _delete_redge(u, v);
+  void update_delete(node_id u, node_id, edge_sno) {
     _update_inaccuracy(u, 1);
     while (index_size(u) < _tpoints[u].size()) {
       log_trace("remove random-walk at node %zu", (size_t)u);
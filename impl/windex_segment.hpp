@@ -0,0 +1,190 @@
+#pragma once
+
+#include <assert.h>
+#include "log/log.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "lib/random.hpp"
+#include "time/counter.hpp"
+#include "fspi_base.hpp"
+#include "simple_walk.hpp"
+
+// random-walk indexing scheme that stitches pooled fixed-length segments
+class windex_segment : public simple_walk, public fspi_base {
+private:
+  struct seginfo {
+    uint8_t leng;   // number of steps taken
+    bool hung;      // stopped early on a dangling node
+  };
+
+  const unsigned _seg_pool, _seg_leng;
+
+  // segment sid of node v is the j-th one of v, sid = (v - 1) * pool + j,
+  // whose path is _paths[sid * (leng + 1), (sid + 1) * (leng + 1))
+  std::vector<node_id> _paths;
+  std::vector<seginfo> _sinfo;
+
+  // segments leaving (or hung on) each node, may hold stale entries
+  std::vector<std::vector<path_id>> _visits;
+  size_t _n_entries, _n_live;
+
+  node_id* _path(path_id sid) {
+    return &_paths[(size_t)sid * (_seg_leng + 1)];
+  }
+
+  const node_id* _path(path_id sid) const {
+    return &_paths[(size_t)sid * (_seg_leng + 1)];
+  }
+
+  path_id _segment(node_id v, unsigned j) const {
+    return (path_id)(v - 1) * _seg_pool + j;
+  }
+
+  bool _leaves(path_id sid, node_id u) const {
+    const node_id* p = _path(sid);
+    auto [leng, hung] = _sinfo[sid];
+    return std::find(p, p + leng + hung, u) != p + leng + hung;
+  }
+
+  // resample the segment from step k on, forcing the next node if given
+  void _extend(path_id sid, unsigned k, node_id next) {
+    node_id* p = _path(sid);
+    _n_live -= _sinfo[sid].leng + _sinfo[sid].hung;
+    for (; k < _seg_leng; ++k) {
+      node_id u = p[k];
+      _visits[u].push_back(sid);
+      ++_n_entries;
+      if (_g->is_dangling_node(u)) {
+        _sinfo[sid] = { (uint8_t)k, true };
+        _n_live += k + 1;
+        return;
+      }
+      p[k + 1] = next ? next : _g->get_neighbour(u,
+        rand_uniform(_g->get_degree(u)));
+      next = 0;
+    }
+    _sinfo[sid] = { (uint8_t)_seg_leng, false };
+    _n_live += _seg_leng;
+  }
+
+  // take out the distinct segments that still leave u
+  void _collect(node_id u, std::vector<path_id>& segs) {
+    segs.clear();
+    segs.swap(_visits[u]);
+    _n_entries -= segs.size();
+    std::sort(segs.begin(), segs.end());
+    segs.erase(std::unique(segs.begin(), segs.end()), segs.end());
+    segs.erase(std::remove_if(segs.begin(), segs.end(),
+      [this, u](path_id sid) { return !_leaves(sid, u); }), segs.end());
+  }
+
+  void _keep(node_id u, path_id sid) {
+    _visits[u].push_back(sid);
+    ++_n_entries;
+  }
+
+  void _compact() {
+    log_debug("compacting %zu visiting entries", _n_entries);
+    static std::vector<path_id> segs;
+    for (node_id u = 1; u <= _g->num_nodes(); ++u) {
+      _collect(u, segs);
+      _visits[u].assign(segs.begin(), segs.end());
+      _n_entries += segs.size();
+    }
+  }
+
+  void _maintain() {
+    if (_n_entries > 2 * _n_live + _g->num_nodes()) _compact();
+  }
+
+public:
+  template <typename C>
+  windex_segment(graph* g, bool is_dird, C config) :
+    fspi_base(g, is_dird, config),
+    _seg_pool(config.seg_pool), _seg_leng(config.seg_length),
+    _paths((size_t)g->num_nodes() * _seg_pool * (_seg_leng + 1)),
+    _sinfo((size_t)g->num_nodes() * _seg_pool, seginfo { 0, false }),
+    _visits(g->num_nodes() + 1),
+    _n_entries(0), _n_live(0)
+  {
+    for (node_id v = 1; v <= _g->num_nodes(); ++v)
+      for (unsigned j = 0; j < _seg_pool; ++j) {
+        path_id sid = _segment(v, j);
+        _path(sid)[0] = v;
+        _extend(sid, 0, 0);
+      }
+    log_debug("sampled %zu segment(s) with %zu step(s)",
+      _sinfo.size(), _n_live);
+  }
+
+  template <typename Vec>
+  void adapt(const Vec&, double) { }
+
+  // the walk length is drawn up front and consumed segment by segment; the
+  // pool of s holds few segments, so the first steps are walked afresh to
+  // keep the samples of a node independent at least that far, later
+  // segments being shared among them
+  node_id get(node_id s, record_sno) const {
+    uint32_t l = rand_geometric(alpha);
+    for (unsigned k = 0; k < _seg_leng && l > 0; ++k, --l) {
+      if (_g->is_dangling_node(s)) return s;
+      s = _g->get_neighbour(s, rand_uniform(_g->get_degree(s)));
+    }
+    for (; l > 0; l -= _seg_leng) {
+      path_id sid = _segment(s, rand_uniform(_seg_pool));
+      const node_id* p = _path(sid);
+      auto [leng, hung] = _sinfo[sid];
+      if (l <= leng) return p[l];
+      if (hung) return p[leng];
+      s = p[_seg_leng];
+    }
+    return s;
+  }
+
+  void update_insert(node_id u, node_id v, edge_sno) {
+    static std::vector<path_id> segs;
+    _collect(u, segs);
+    log_debug("checking %zu segment(s) leaving %zu", segs.size(), (size_t)u);
+    double p = 1. / _g->get_degree(u);
+    size_t n_upd = 0;
+    for (path_id sid : segs) {
+      const node_id* pth = _path(sid);
+      auto [leng, hung] = _sinfo[sid];
+      // each departure from u switches to the new edge with probability p,
+      // and a segment hung on u now leaves through it
+      unsigned k = 0;
+      while (k < leng && !(pth[k] == u && rand_uniformf() < p)) ++k;
+      if (k < leng || (hung && pth[leng] == u)) {
+        ++n_upd;
+        _extend(sid, k, v);
+      } else {
+        _keep(u, sid);
+      }
+    }
+    log_debug("resampled %zu segment(s)", n_upd);
+    count_work(WALK_REPAIR, n_upd);
+    _maintain();
+  }
+
+  void update_delete(node_id u, node_id v, edge_sno) {
+    static std::vector<path_id> segs;
+    _collect(u, segs);
+    log_debug("checking %zu segment(s) leaving %zu", segs.size(), (size_t)u);
+    size_t n_upd = 0;
+    for (path_id sid : segs) {
+      const node_id* pth = _path(sid);
+      unsigned k = 0, leng = _sinfo[sid].leng;
+      while (k < leng && !(pth[k] == u && pth[k + 1] == v)) ++k;
+      if (k < leng) {
+        ++n_upd;
+        _extend(sid, k, 0);
+      } else {
+        _keep(u, sid);
+      }
+    }
+    log_debug("resampled %zu segment(s)", n_upd);
+    count_work(WALK_REPAIR, n_upd);
+    _maintain();
+  }
+};